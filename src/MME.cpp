@@ -1612,3 +1612,244 @@ Rcpp::List solveMKM(arma::mat& y, arma::mat& X,
                             Rcpp::Named("LL")=llik,
                             Rcpp::Named("iter")=iter);
 }
+
+// Loci per panel and individuals per block for the marker scan.
+// Dosages for a panel of loci and a block of individuals are decoded
+// from the packed haplotypes into a buffer that stays in cache while
+// it is multiplied with the matching rows of W.
+const arma::uword scanPanel = 64;
+const arma::uword scanBlock = 256;
+
+// Cross-products of allele dosages with the columns of W
+// Returns a matrix with a column for each locus. The first rows are
+// W'g, followed by sum(g) and sum(g^2).
+arma::mat scanCrossProd(const GenoView& geno, 
+                        const arma::Col<int>& lociPerChr,
+                        const arma::uvec& lociLoc, const arma::mat& W,
+                        int nThreads){
+  arma::uword nInd = geno.nInd;
+  arma::uword nW = W.n_cols;
+  arma::uword nLoci = lociLoc.n_elem;
+  std::vector<arma::uword> locChr(nLoci), locBin(nLoci), locBit(nLoci);
+  arma::uword loc = 0;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    for(int k=0; k<lociPerChr(chr); ++k){
+      locChr[loc] = chr;
+      locBin[loc] = (lociLoc(loc)-1)/8; // R to C++
+      locBit[loc] = (lociLoc(loc)-1)%8;
+      ++loc;
+    }
+  }
+  arma::mat output(nW+2,nLoci,arma::fill::zeros);
+  arma::uword nPanels = (nLoci+scanPanel-1)/scanPanel;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+#endif
+  for(arma::uword p=0; p<nPanels; ++p){
+    arma::uword start = p*scanPanel;
+    arma::uword nP = std::min(scanPanel,nLoci-start);
+    unsigned char dosage[scanPanel*scanBlock];
+    for(arma::uword b=0; b<nInd; b+=scanBlock){
+      arma::uword nB = std::min(scanBlock,nInd-b);
+      // Decode dosages
+      for(arma::uword m=0; m<nP; ++m){
+        arma::uword i = start+m;
+        unsigned char* d = dosage + m*scanBlock;
+        for(arma::uword j=0; j<nB; ++j){
+          unsigned char x = 0;
+          for(arma::uword h=0; h<geno.ploidy; ++h){
+            x += (geno.haplo(locChr[i],h,b+j)[locBin[i]] >> locBit[i]) & 1;
+          }
+          d[j] = x;
+        }
+      }
+      // Accumulate cross-products
+      for(arma::uword m=0; m<nP; ++m){
+        const unsigned char* d = dosage + m*scanBlock;
+        double* out = output.colptr(start+m);
+        for(arma::uword k=0; k<nW; ++k){
+          const double* w = W.colptr(k) + b;
+          double s = 0;
+          for(arma::uword j=0; j<nB; ++j){
+            s += double(d[j])*w[j];
+          }
+          out[k] += s;
+        }
+        arma::uword s1 = 0, s2 = 0;
+        for(arma::uword j=0; j<nB; ++j){
+          s1 += d[j];
+          s2 += d[j]*d[j];
+        }
+        out[nW] += double(s1);
+        out[nW+1] += double(s2);
+      }
+    }
+  }
+  return output;
+}
+
+// Regression statistics for loci from scanCrossProd
+// Q is an orthonormal basis for the fixed effects and Yr holds the
+// responses after projecting out the fixed effects. Dosages are
+// centered before projection for numerical stability, which is valid
+// because the fixed effects include an intercept. Loci are written
+// to rows of the output starting at row start.
+void scanStats(const arma::mat& cp, const arma::mat& Q, 
+               const arma::mat& Yr, arma::uword start,
+               arma::mat& effect, arma::mat& se, arma::mat& pValue){
+  double n = double(Q.n_rows);
+  arma::uword q = Q.n_cols;
+  arma::uword nTraits = Yr.n_cols;
+  double df = n-double(q)-1.0;
+  arma::rowvec Q1 = sum(Q);
+  arma::rowvec ySum = sum(Yr);
+  arma::rowvec yy = sum(Yr%Yr);
+  for(arma::uword i=0; i<cp.n_cols; ++i){
+    double gBar = cp(q+nTraits,i)/n;
+    double ggc = cp(q+nTraits+1,i) - n*gBar*gBar;
+    arma::vec Qg = cp.col(i).head(q) - gBar*Q1.t();
+    double gg = ggc - dot(Qg,Qg);
+    for(arma::uword t=0; t<nTraits; ++t){
+      if((ggc<=0) || (gg<=(1.0e-10*ggc))){
+        // Monomorphic or confounded with fixed effects
+        effect(start+i,t) = NA_REAL;
+        se(start+i,t) = NA_REAL;
+        pValue(start+i,t) = NA_REAL;
+        continue;
+      }
+      double gy = cp(q+t,i) - gBar*ySum(t);
+      double beta = gy/gg;
+      double sigma2 = std::max(yy(t)-beta*gy,0.0)/df;
+      effect(start+i,t) = beta;
+      se(start+i,t) = sqrt(sigma2/gg);
+      pValue(start+i,t) = 2.0*R::pt(-std::abs(beta/se(start+i,t)),df,1,0);
+    }
+  }
+}
+
+// Allele dosages of loci on one chromosome
+arma::Mat<unsigned char> chrDosage(const GenoView& geno, 
+                                   const arma::Col<int>& lociPerChr,
+                                   const arma::uvec& lociLoc, arma::uword chr,
+                                   arma::uword start, int nThreads){
+  arma::Col<int> chrLoci(lociPerChr.n_elem,arma::fill::zeros);
+  chrLoci(chr) = lociPerChr(chr);
+  return getGeno(geno,chrLoci,lociLoc.subvec(start,start+lociPerChr(chr)-1),
+                 nThreads);
+}
+
+// Polygenic background of each column of y, i.e. u from solveUVM with 
+// Z=I and relationship matrix K. Q is an orthonormal basis for the 
+// fixed effects. The eigendecomposition of the projected K is shared 
+// by all columns, with u = K*P*y for the REML projection matrix P.
+arma::mat gblupBackground(const arma::mat& y, const arma::mat& Q,
+                          const arma::mat& K){
+  arma::uword n = y.n_rows;
+  arma::uword q = Q.n_cols;
+  double df = double(n)-double(q);
+  double offset = log(double(n));
+  
+  // Same system as solveUVM
+  arma::mat S = -(Q*Q.t());
+  S.diag() += 1;
+  arma::mat H = K;
+  H.diag() += offset;
+  S = S*H*S;
+  arma::vec eigval(n);
+  arma::mat eigvec(n,n);
+  eigen2(eigval, eigvec, S);
+  eigval = eigval(arma::span(q,eigvec.n_cols-1)) - offset;
+  eigvec = eigvec(arma::span(0,eigvec.n_rows-1),
+                  arma::span(q,eigvec.n_cols-1));
+  
+  arma::mat eta = eigvec.t()*y;
+  arma::mat Py(eta.n_rows,y.n_cols);
+  for(arma::uword t=0; t<y.n_cols; ++t){
+    Rcpp::List optRes = optimize(*objREML,
+                                 Rcpp::List::create(
+                                   Rcpp::Named("df")=df,
+                                   Rcpp::Named("eta")=arma::vec(eta.col(t)),
+                                   Rcpp::Named("lambda")=eigval),
+                                   1.0e-10, 1.0e10);
+    double delta = optRes["parameter"];
+    Py.col(t) = eta.col(t)/(eigval+delta);
+  }
+  return K*(eigvec*Py);
+}
+
+// Called by GWAS function
+// Single marker regression of responses on allele dosage, after
+// projecting out fixed effects built with makeX. With loco, the
+// polygenic background of each chromosome's loci is first removed
+// from the responses. This uses GBLUP with a genomic relationship
+// matrix built from the loci on all other chromosomes, fit as in
+// solveUVM with one eigendecomposition per chromosome for all traits.
+// [[Rcpp::export]]
+Rcpp::List callGWAS(arma::mat y, arma::uvec x, SEXP geno, 
+                    arma::Col<int> lociPerChr, arma::uvec lociLoc,
+                    bool loco, int nThreads){
+  GenoView view(geno);
+  arma::uword n = y.n_rows;
+  arma::uword nTraits = y.n_cols;
+  arma::uword nLoci = lociLoc.n_elem;
+  arma::mat X = makeX(x);
+  if(n<(X.n_cols+2)){
+    Rcpp::stop("Not enough individuals for the number of fixed effects");
+  }
+  arma::mat Q, R;
+  qr_econ(Q,R,X);
+  arma::mat effect(nLoci,nTraits), se(nLoci,nTraits), pValue(nLoci,nTraits);
+  if(!loco){
+    arma::mat Yr = y - Q*(Q.t()*y);
+    arma::mat cp = scanCrossProd(view,lociPerChr,lociLoc,
+                                 join_rows(Q,Yr),nThreads);
+    scanStats(cp,Q,Yr,0,effect,se,pValue);
+  }else{
+    arma::uword nChr = lociPerChr.n_elem;
+    arma::uvec chrStart(nChr);
+    arma::uword start = 0;
+    for(arma::uword chr=0; chr<nChr; ++chr){
+      chrStart(chr) = start;
+      start += lociPerChr(chr);
+    }
+    if(arma::uword(max(lociPerChr))==nLoci){
+      Rcpp::stop("loco requires loci on more than one chromosome");
+    }
+    // Dosages are decoded once and kept for the relationships and the 
+    // scan of each chromosome
+    arma::field<arma::Mat<unsigned char> > dosage(nChr);
+    arma::field<arma::rowvec> dosageMean(nChr);
+    arma::mat G(n,n,arma::fill::zeros);
+    for(arma::uword chr=0; chr<nChr; ++chr){
+      if(lociPerChr(chr)>0){
+        dosage(chr) = chrDosage(view,lociPerChr,lociLoc,chr,
+                                chrStart(chr),nThreads);
+        arma::mat Z = arma::conv_to<arma::mat>::from(dosage(chr));
+        dosageMean(chr) = mean(Z);
+        Z.each_row() -= dosageMean(chr);
+        G += Z*Z.t();
+      }
+    }
+    for(arma::uword chr=0; chr<nChr; ++chr){
+      if(lociPerChr(chr)==0){
+        continue;
+      }
+      arma::mat Z = arma::conv_to<arma::mat>::from(dosage(chr));
+      dosage(chr).reset();
+      arma::mat cp(Q.n_cols+nTraits+2,Z.n_cols);
+      cp.row(Q.n_cols+nTraits) = sum(Z);
+      cp.row(Q.n_cols+nTraits+1) = sum(Z%Z);
+      Z.each_row() -= dosageMean(chr);
+      arma::mat K = (G-Z*Z.t())/double(nLoci-lociPerChr(chr));
+      arma::mat yAdj = y - gblupBackground(y,Q,K);
+      arma::mat Yr = yAdj - Q*(Q.t()*yAdj);
+      // Cross-products laid out as in scanCrossProd
+      arma::mat W = join_rows(Q,Yr);
+      cp.rows(0,W.n_cols-1) = W.t()*Z + sum(W).t()*dosageMean(chr);
+      scanStats(cp,Q,Yr,chrStart(chr),effect,se,pValue);
+    }
+  }
+  return Rcpp::List::create(Rcpp::Named("effect")=effect,
+                            Rcpp::Named("se")=se,
+                            Rcpp::Named("pValue")=pValue);
+}
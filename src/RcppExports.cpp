@@ -349,9 +349,26 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// callGWAS
+Rcpp::List callGWAS(arma::mat y, arma::uvec x, SEXP geno, arma::Col<int> lociPerChr, arma::uvec lociLoc, bool loco, int nThreads);
+RcppExport SEXP _AlphaSimR_callGWAS(SEXP ySEXP, SEXP xSEXP, SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP locoSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::mat >::type y(ySEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< arma::Col<int> >::type lociPerChr(lociPerChrSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
+    Rcpp::traits::input_parameter< bool >::type loco(locoSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(callGWAS(y, x, geno, lociPerChr, lociLoc, loco, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // writeASGenotypes
-void writeASGenotypes(const arma::Cube<unsigned char>& g, const arma::field<arma::uvec>& locations, const arma::uvec& allLocations, const arma::vec& snpchips, const std::vector<std::string>& names, const char missing, const std::string fname);
-RcppExport SEXP _AlphaSimR_writeASGenotypes(SEXP gSEXP, SEXP locationsSEXP, SEXP allLocationsSEXP, SEXP snpchipsSEXP, SEXP namesSEXP, SEXP missingSEXP, SEXP fnameSEXP) {
+void writeASGenotypes(const arma::Cube<unsigned char>& g, const arma::field<arma::uvec>& locations, const arma::uvec& allLocations, const arma::vec& snpchips, const std::vector<std::string>& names, const char missing, const std::string fname, int nThreads);
+RcppExport SEXP _AlphaSimR_writeASGenotypes(SEXP gSEXP, SEXP locationsSEXP, SEXP allLocationsSEXP, SEXP snpchipsSEXP, SEXP namesSEXP, SEXP missingSEXP, SEXP fnameSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const arma::Cube<unsigned char>& >::type g(gSEXP);
@@ -361,13 +378,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const std::vector<std::string>& >::type names(namesSEXP);
     Rcpp::traits::input_parameter< const char >::type missing(missingSEXP);
     Rcpp::traits::input_parameter< const std::string >::type fname(fnameSEXP);
-    writeASGenotypes(g, locations, allLocations, snpchips, names, missing, fname);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    writeASGenotypes(g, locations, allLocations, snpchips, names, missing, fname, nThreads);
     return R_NilValue;
 END_RCPP
 }
 // writeASHaplotypes
-void writeASHaplotypes(const arma::Cube<unsigned char>& g, const arma::field<arma::uvec>& locations, const arma::uvec& allLocations, const arma::vec& snpchips, const std::vector<std::string>& names, const char missing, const std::string fname);
-RcppExport SEXP _AlphaSimR_writeASHaplotypes(SEXP gSEXP, SEXP locationsSEXP, SEXP allLocationsSEXP, SEXP snpchipsSEXP, SEXP namesSEXP, SEXP missingSEXP, SEXP fnameSEXP) {
+void writeASHaplotypes(const arma::Cube<unsigned char>& g, const arma::field<arma::uvec>& locations, const arma::uvec& allLocations, const arma::vec& snpchips, const std::vector<std::string>& names, const char missing, const std::string fname, int nThreads);
+RcppExport SEXP _AlphaSimR_writeASHaplotypes(SEXP gSEXP, SEXP locationsSEXP, SEXP allLocationsSEXP, SEXP snpchipsSEXP, SEXP namesSEXP, SEXP missingSEXP, SEXP fnameSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const arma::Cube<unsigned char>& >::type g(gSEXP);
@@ -377,13 +395,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const std::vector<std::string>& >::type names(namesSEXP);
     Rcpp::traits::input_parameter< const char >::type missing(missingSEXP);
     Rcpp::traits::input_parameter< const std::string >::type fname(fnameSEXP);
-    writeASHaplotypes(g, locations, allLocations, snpchips, names, missing, fname);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    writeASHaplotypes(g, locations, allLocations, snpchips, names, missing, fname, nThreads);
     return R_NilValue;
 END_RCPP
 }
-// argAltAD
-Rcpp::List argAltAD(Rcpp::S4 LociMap, Rcpp::S4 Pop, double mean, double varA, double varD, double inbrDepr, int nThreads);
-RcppExport SEXP _AlphaSimR_argAltAD(SEXP LociMapSEXP, SEXP PopSEXP, SEXP meanSEXP, SEXP varASEXP, SEXP varDSEXP, SEXP inbrDeprSEXP, SEXP nThreadsSEXP) {
+// calcAltAD
+Rcpp::List calcAltAD(Rcpp::S4 LociMap, Rcpp::S4 Pop, double mean, double varA, double varD, double inbrDepr, arma::vec limMeanDD, arma::vec limVarDD, int nThreads);
+RcppExport SEXP _AlphaSimR_calcAltAD(SEXP LociMapSEXP, SEXP PopSEXP, SEXP meanSEXP, SEXP varASEXP, SEXP varDSEXP, SEXP inbrDeprSEXP, SEXP limMeanDDSEXP, SEXP limVarDDSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -393,55 +412,139 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type varA(varASEXP);
     Rcpp::traits::input_parameter< double >::type varD(varDSEXP);
     Rcpp::traits::input_parameter< double >::type inbrDepr(inbrDeprSEXP);
+    Rcpp::traits::input_parameter< arma::vec >::type limMeanDD(limMeanDDSEXP);
+    Rcpp::traits::input_parameter< arma::vec >::type limVarDD(limVarDDSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(argAltAD(LociMap, Pop, mean, varA, varD, inbrDepr, nThreads));
+    rcpp_result_gen = Rcpp::wrap(calcAltAD(LociMap, Pop, mean, varA, varD, inbrDepr, limMeanDD, limVarDD, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
-// objAltAD
-double objAltAD(arma::vec input, const Rcpp::List& args);
-RcppExport SEXP _AlphaSimR_objAltAD(SEXP inputSEXP, SEXP argsSEXP) {
+// calcGenParam
+Rcpp::List calcGenParam(const Rcpp::S4& trait, const Rcpp::S4& pop, int nThreads);
+RcppExport SEXP _AlphaSimR_calcGenParam(SEXP traitSEXP, SEXP popSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< arma::vec >::type input(inputSEXP);
-    Rcpp::traits::input_parameter< const Rcpp::List& >::type args(argsSEXP);
-    rcpp_result_gen = Rcpp::wrap(objAltAD(input, args));
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type trait(traitSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type pop(popSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcGenParam(trait, pop, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
-// finAltAD
-Rcpp::List finAltAD(arma::vec input, const Rcpp::List& args);
-RcppExport SEXP _AlphaSimR_finAltAD(SEXP inputSEXP, SEXP argsSEXP) {
+// calcGenoCount
+arma::umat calcGenoCount(const Rcpp::S4& lociMap, const Rcpp::S4& pop, int nThreads);
+RcppExport SEXP _AlphaSimR_calcGenoCount(SEXP lociMapSEXP, SEXP popSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< arma::vec >::type input(inputSEXP);
-    Rcpp::traits::input_parameter< const Rcpp::List& >::type args(argsSEXP);
-    rcpp_result_gen = Rcpp::wrap(finAltAD(input, args));
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type lociMap(lociMapSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type pop(popSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcGenoCount(lociMap, pop, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
-// calcGenParam
-Rcpp::List calcGenParam(const Rcpp::S4& trait, const Rcpp::S4& pop, int nThreads);
-RcppExport SEXP _AlphaSimR_calcGenParam(SEXP traitSEXP, SEXP popSEXP, SEXP nThreadsSEXP) {
+// calcGenicParam
+Rcpp::List calcGenicParam(const Rcpp::S4& trait, const Rcpp::S4& pop, int nThreads);
+RcppExport SEXP _AlphaSimR_calcGenicParam(SEXP traitSEXP, SEXP popSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type trait(traitSEXP);
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type pop(popSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(calcGenParam(trait, pop, nThreads));
+    rcpp_result_gen = Rcpp::wrap(calcGenicParam(trait, pop, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcLdWindow
+Rcpp::List calcLdWindow(SEXP geno, arma::uword chr, arma::uvec loci, arma::uword window, int nThreads);
+RcppExport SEXP _AlphaSimR_calcLdWindow(SEXP genoSEXP, SEXP chrSEXP, SEXP lociSEXP, SEXP windowSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type chr(chrSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type loci(lociSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcLdWindow(geno, chr, loci, window, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcLdPair
+Rcpp::List calcLdPair(SEXP geno, arma::uword chr, arma::uvec loci1, arma::uvec loci2, int nThreads);
+RcppExport SEXP _AlphaSimR_calcLdPair(SEXP genoSEXP, SEXP chrSEXP, SEXP loci1SEXP, SEXP loci2SEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type chr(chrSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type loci1(loci1SEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type loci2(loci2SEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcLdPair(geno, chr, loci1, loci2, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mapGenoFile
+Rcpp::List mapGenoFile(Rcpp::List geno, Rcpp::String filePath, bool keepFile);
+RcppExport SEXP _AlphaSimR_mapGenoFile(SEXP genoSEXP, SEXP filePathSEXP, SEXP keepFileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type filePath(filePathSEXP);
+    Rcpp::traits::input_parameter< bool >::type keepFile(keepFileSEXP);
+    rcpp_result_gen = Rcpp::wrap(mapGenoFile(geno, filePath, keepFile));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mergeGeno
+Rcpp::List mergeGeno(Rcpp::List x, Rcpp::List y);
+RcppExport SEXP _AlphaSimR_mergeGeno(SEXP xSEXP, SEXP ySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(mergeGeno(x, y));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mergeMultGeno
+Rcpp::List mergeMultGeno(Rcpp::List& popList, arma::uvec nBin, arma::uword ploidy);
+RcppExport SEXP _AlphaSimR_mergeMultGeno(SEXP popListSEXP, SEXP nBinSEXP, SEXP ploidySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List& >::type popList(popListSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type nBin(nBinSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type ploidy(ploidySEXP);
+    rcpp_result_gen = Rcpp::wrap(mergeMultGeno(popList, nBin, ploidy));
+    return rcpp_result_gen;
+END_RCPP
+}
+// poolGeno
+Rcpp::List poolGeno(SEXP geno, int nThreads);
+RcppExport SEXP _AlphaSimR_poolGeno(SEXP genoSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(poolGeno(geno, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
 // getGeno
-arma::Mat<unsigned char> getGeno(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
+arma::Mat<unsigned char> getGeno(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
 RcppExport SEXP _AlphaSimR_getGeno(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
@@ -450,12 +553,12 @@ BEGIN_RCPP
 END_RCPP
 }
 // getMaternalGeno
-arma::Mat<unsigned char> getMaternalGeno(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
+arma::Mat<unsigned char> getMaternalGeno(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
 RcppExport SEXP _AlphaSimR_getMaternalGeno(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
@@ -464,12 +567,12 @@ BEGIN_RCPP
 END_RCPP
 }
 // getPaternalGeno
-arma::Mat<unsigned char> getPaternalGeno(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
+arma::Mat<unsigned char> getPaternalGeno(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
 RcppExport SEXP _AlphaSimR_getPaternalGeno(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
@@ -478,12 +581,12 @@ BEGIN_RCPP
 END_RCPP
 }
 // getHaplo
-arma::Mat<unsigned char> getHaplo(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
+arma::Mat<unsigned char> getHaplo(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
 RcppExport SEXP _AlphaSimR_getHaplo(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
@@ -492,12 +595,12 @@ BEGIN_RCPP
 END_RCPP
 }
 // getOneHaplo
-arma::Mat<unsigned char> getOneHaplo(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int haplo, int nThreads);
+arma::Mat<unsigned char> getOneHaplo(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int haplo, int nThreads);
 RcppExport SEXP _AlphaSimR_getOneHaplo(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP haploSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< int >::type haplo(haploSEXP);
@@ -522,11 +625,11 @@ BEGIN_RCPP
 END_RCPP
 }
 // writeGeno
-void writeGeno(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, Rcpp::String filePath, int nThreads);
+void writeGeno(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, Rcpp::String filePath, int nThreads);
 RcppExport SEXP _AlphaSimR_writeGeno(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP filePathSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< Rcpp::String >::type filePath(filePathSEXP);
@@ -536,11 +639,11 @@ BEGIN_RCPP
 END_RCPP
 }
 // writeOneHaplo
-void writeOneHaplo(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int haplo, Rcpp::String filePath, int nThreads);
+void writeOneHaplo(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int haplo, Rcpp::String filePath, int nThreads);
 RcppExport SEXP _AlphaSimR_writeOneHaplo(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP haploSEXP, SEXP filePathSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< int >::type haplo(haploSEXP);
@@ -550,13 +653,58 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// writeRecordsBin
+void writeRecordsBin(SEXP genoList, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, const arma::mat& gv, const arma::mat& pheno, Rcpp::String filePath, int nThreads, arma::uword chunkSize);
+RcppExport SEXP _AlphaSimR_writeRecordsBin(SEXP genoListSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP gvSEXP, SEXP phenoSEXP, SEXP filePathSEXP, SEXP nThreadsSEXP, SEXP chunkSizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type genoList(genoListSEXP);
+    Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
+    Rcpp::traits::input_parameter< const arma::mat& >::type gv(gvSEXP);
+    Rcpp::traits::input_parameter< const arma::mat& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type filePath(filePathSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type chunkSize(chunkSizeSEXP);
+    writeRecordsBin(genoList, lociPerChr, lociLoc, gv, pheno, filePath, nThreads, chunkSize);
+    return R_NilValue;
+END_RCPP
+}
+// readRecordsBin
+Rcpp::List readRecordsBin(Rcpp::String filePath, arma::uvec gen, arma::uvec markers, int nThreads);
+RcppExport SEXP _AlphaSimR_readRecordsBin(SEXP filePathSEXP, SEXP genSEXP, SEXP markersSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::String >::type filePath(filePathSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type gen(genSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type markers(markersSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(readRecordsBin(filePath, gen, markers, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// writeBed
+void writeBed(SEXP genoList, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, Rcpp::String filePath, int nThreads);
+RcppExport SEXP _AlphaSimR_writeBed(SEXP genoListSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP filePathSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type genoList(genoListSEXP);
+    Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type filePath(filePathSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    writeBed(genoList, lociPerChr, lociLoc, filePath, nThreads);
+    return R_NilValue;
+END_RCPP
+}
 // calcGenoFreq
-arma::rowvec calcGenoFreq(const arma::field<arma::Cube<unsigned char> >& geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
+arma::rowvec calcGenoFreq(SEXP geno, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
 RcppExport SEXP _AlphaSimR_calcGenoFreq(SEXP genoSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
     Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
@@ -564,14 +712,15 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// calcChrFreq
-arma::rowvec calcChrFreq(const arma::Cube<unsigned char>& geno);
-RcppExport SEXP _AlphaSimR_calcChrFreq(SEXP genoSEXP) {
+// calcAlleleFreq
+arma::field<arma::rowvec> calcAlleleFreq(SEXP geno, int nThreads);
+RcppExport SEXP _AlphaSimR_calcAlleleFreq(SEXP genoSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::Cube<unsigned char>& >::type geno(genoSEXP);
-    rcpp_result_gen = Rcpp::wrap(calcChrFreq(geno));
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcAlleleFreq(geno, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -588,6 +737,19 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// getGvMulti
+Rcpp::List getGvMulti(Rcpp::List traits, const Rcpp::S4& pop, int nThreads);
+RcppExport SEXP _AlphaSimR_getGvMulti(SEXP traitsSEXP, SEXP popSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type traits(traitsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type pop(popSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(getGvMulti(traits, pop, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // getHybridGv
 arma::field<arma::vec> getHybridGv(const Rcpp::S4& trait, const Rcpp::S4& females, arma::uvec femaleParents, const Rcpp::S4& males, arma::uvec maleParents, int nThreads);
 RcppExport SEXP _AlphaSimR_getHybridGv(SEXP traitSEXP, SEXP femalesSEXP, SEXP femaleParentsSEXP, SEXP malesSEXP, SEXP maleParentsSEXP, SEXP nThreadsSEXP) {
@@ -604,6 +766,20 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// getHybridGvFactorial
+arma::field<arma::mat> getHybridGvFactorial(const Rcpp::S4& trait, const Rcpp::S4& females, const Rcpp::S4& males, int nThreads);
+RcppExport SEXP _AlphaSimR_getHybridGvFactorial(SEXP traitSEXP, SEXP femalesSEXP, SEXP malesSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type trait(traitSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type females(femalesSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type males(malesSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(getHybridGvFactorial(trait, females, males, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // getNonFounderIbd
 arma::field<    arma::field<      arma::Mat<int> > > getNonFounderIbd(const arma::field<arma::field<arma::Mat<int> > >& recHist, const arma::field<arma::field<arma::Mat<int> > >& mother, const arma::field<arma::field<arma::Mat<int> > >& father);
 RcppExport SEXP _AlphaSimR_getNonFounderIbd(SEXP recHistSEXP, SEXP motherSEXP, SEXP fatherSEXP) {
@@ -644,15 +820,31 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// readVcf
+Rcpp::List readVcf(Rcpp::String filePath, Rcpp::List genMap, arma::uword ploidy, arma::uword nLines, int nThreads, bool verbose);
+RcppExport SEXP _AlphaSimR_readVcf(SEXP filePathSEXP, SEXP genMapSEXP, SEXP ploidySEXP, SEXP nLinesSEXP, SEXP nThreadsSEXP, SEXP verboseSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::String >::type filePath(filePathSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type genMap(genMapSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type ploidy(ploidySEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type nLines(nLinesSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type verbose(verboseSEXP);
+    rcpp_result_gen = Rcpp::wrap(readVcf(filePath, genMap, ploidy, nLines, nThreads, verbose));
+    return rcpp_result_gen;
+END_RCPP
+}
 // cross
-Rcpp::List cross(const arma::field<arma::Cube<unsigned char> >& motherGeno, arma::uvec mother, const arma::field<arma::Cube<unsigned char> >& fatherGeno, arma::uvec father, const arma::field<arma::vec>& femaleMap, const arma::field<arma::vec>& maleMap, bool trackRec, arma::uword motherPloidy, arma::uword fatherPloidy, double v, double p, const arma::vec& motherCentromere, const arma::vec& fatherCentromere, double quadProb, int nThreads);
-RcppExport SEXP _AlphaSimR_cross(SEXP motherGenoSEXP, SEXP motherSEXP, SEXP fatherGenoSEXP, SEXP fatherSEXP, SEXP femaleMapSEXP, SEXP maleMapSEXP, SEXP trackRecSEXP, SEXP motherPloidySEXP, SEXP fatherPloidySEXP, SEXP vSEXP, SEXP pSEXP, SEXP motherCentromereSEXP, SEXP fatherCentromereSEXP, SEXP quadProbSEXP, SEXP nThreadsSEXP) {
+Rcpp::List cross(SEXP motherGenoList, arma::uvec mother, SEXP fatherGenoList, arma::uvec father, const arma::field<arma::vec>& femaleMap, const arma::field<arma::vec>& maleMap, bool trackRec, arma::uword motherPloidy, arma::uword fatherPloidy, double v, double p, const arma::vec& motherCentromere, const arma::vec& fatherCentromere, double quadProb, int nThreads);
+RcppExport SEXP _AlphaSimR_cross(SEXP motherGenoListSEXP, SEXP motherSEXP, SEXP fatherGenoListSEXP, SEXP fatherSEXP, SEXP femaleMapSEXP, SEXP maleMapSEXP, SEXP trackRecSEXP, SEXP motherPloidySEXP, SEXP fatherPloidySEXP, SEXP vSEXP, SEXP pSEXP, SEXP motherCentromereSEXP, SEXP fatherCentromereSEXP, SEXP quadProbSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type motherGeno(motherGenoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type motherGenoList(motherGenoListSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type mother(motherSEXP);
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type fatherGeno(fatherGenoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type fatherGenoList(fatherGenoListSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type father(fatherSEXP);
     Rcpp::traits::input_parameter< const arma::field<arma::vec>& >::type femaleMap(femaleMapSEXP);
     Rcpp::traits::input_parameter< const arma::field<arma::vec>& >::type maleMap(maleMapSEXP);
@@ -665,34 +857,55 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const arma::vec& >::type fatherCentromere(fatherCentromereSEXP);
     Rcpp::traits::input_parameter< double >::type quadProb(quadProbSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(cross(motherGeno, mother, fatherGeno, father, femaleMap, maleMap, trackRec, motherPloidy, fatherPloidy, v, p, motherCentromere, fatherCentromere, quadProb, nThreads));
+    rcpp_result_gen = Rcpp::wrap(cross(motherGenoList, mother, fatherGenoList, father, femaleMap, maleMap, trackRec, motherPloidy, fatherPloidy, v, p, motherCentromere, fatherCentromere, quadProb, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// forwardSim
+Rcpp::List forwardSim(arma::field<arma::Cube<unsigned char> > geno, const arma::field<arma::vec>& genMap, arma::uword Ne, arma::uword nGen, double mutRate, const arma::field<arma::vec>& addEff, double selProp, double varE, double v, double p, int nThreads);
+RcppExport SEXP _AlphaSimR_forwardSim(SEXP genoSEXP, SEXP genMapSEXP, SEXP NeSEXP, SEXP nGenSEXP, SEXP mutRateSEXP, SEXP addEffSEXP, SEXP selPropSEXP, SEXP varESEXP, SEXP vSEXP, SEXP pSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::field<arma::Cube<unsigned char> > >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< const arma::field<arma::vec>& >::type genMap(genMapSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type Ne(NeSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type nGen(nGenSEXP);
+    Rcpp::traits::input_parameter< double >::type mutRate(mutRateSEXP);
+    Rcpp::traits::input_parameter< const arma::field<arma::vec>& >::type addEff(addEffSEXP);
+    Rcpp::traits::input_parameter< double >::type selProp(selPropSEXP);
+    Rcpp::traits::input_parameter< double >::type varE(varESEXP);
+    Rcpp::traits::input_parameter< double >::type v(vSEXP);
+    Rcpp::traits::input_parameter< double >::type p(pSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(forwardSim(geno, genMap, Ne, nGen, mutRate, addEff, selProp, varE, v, p, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
 // createDH2
-Rcpp::List createDH2(const arma::field<arma::Cube<unsigned char> >& geno, arma::uword nDH, const arma::field<arma::vec>& genMap, double v, double p, bool trackRec, int nThreads);
-RcppExport SEXP _AlphaSimR_createDH2(SEXP genoSEXP, SEXP nDHSEXP, SEXP genMapSEXP, SEXP vSEXP, SEXP pSEXP, SEXP trackRecSEXP, SEXP nThreadsSEXP) {
+Rcpp::List createDH2(SEXP genoList, arma::uword nDH, const arma::field<arma::vec>& genMap, double v, double p, bool trackRec, int nThreads);
+RcppExport SEXP _AlphaSimR_createDH2(SEXP genoListSEXP, SEXP nDHSEXP, SEXP genMapSEXP, SEXP vSEXP, SEXP pSEXP, SEXP trackRecSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type genoList(genoListSEXP);
     Rcpp::traits::input_parameter< arma::uword >::type nDH(nDHSEXP);
     Rcpp::traits::input_parameter< const arma::field<arma::vec>& >::type genMap(genMapSEXP);
     Rcpp::traits::input_parameter< double >::type v(vSEXP);
     Rcpp::traits::input_parameter< double >::type p(pSEXP);
     Rcpp::traits::input_parameter< bool >::type trackRec(trackRecSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(createDH2(geno, nDH, genMap, v, p, trackRec, nThreads));
+    rcpp_result_gen = Rcpp::wrap(createDH2(genoList, nDH, genMap, v, p, trackRec, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
 // createReducedGenome
-Rcpp::List createReducedGenome(const arma::field<arma::Cube<unsigned char> >& geno, arma::uword nProgeny, const arma::field<arma::vec>& genMap, double v, double p, bool trackRec, arma::uword ploidy, arma::vec& centromere, double quadProb, int nThreads);
-RcppExport SEXP _AlphaSimR_createReducedGenome(SEXP genoSEXP, SEXP nProgenySEXP, SEXP genMapSEXP, SEXP vSEXP, SEXP pSEXP, SEXP trackRecSEXP, SEXP ploidySEXP, SEXP centromereSEXP, SEXP quadProbSEXP, SEXP nThreadsSEXP) {
+Rcpp::List createReducedGenome(SEXP genoList, arma::uword nProgeny, const arma::field<arma::vec>& genMap, double v, double p, bool trackRec, arma::uword ploidy, arma::vec& centromere, double quadProb, int nThreads);
+RcppExport SEXP _AlphaSimR_createReducedGenome(SEXP genoListSEXP, SEXP nProgenySEXP, SEXP genMapSEXP, SEXP vSEXP, SEXP pSEXP, SEXP trackRecSEXP, SEXP ploidySEXP, SEXP centromereSEXP, SEXP quadProbSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type genoList(genoListSEXP);
     Rcpp::traits::input_parameter< arma::uword >::type nProgeny(nProgenySEXP);
     Rcpp::traits::input_parameter< const arma::field<arma::vec>& >::type genMap(genMapSEXP);
     Rcpp::traits::input_parameter< double >::type v(vSEXP);
@@ -702,7 +915,7 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< arma::vec& >::type centromere(centromereSEXP);
     Rcpp::traits::input_parameter< double >::type quadProb(quadProbSEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(createReducedGenome(geno, nProgeny, genMap, v, p, trackRec, ploidy, centromere, quadProb, nThreads));
+    rcpp_result_gen = Rcpp::wrap(createReducedGenome(genoList, nProgeny, genMap, v, p, trackRec, ploidy, centromere, quadProb, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -717,32 +930,6 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// mergeGeno
-arma::field<arma::Cube<unsigned char> > mergeGeno(const arma::field<arma::Cube<unsigned char> >& x, const arma::field<arma::Cube<unsigned char> >& y);
-RcppExport SEXP _AlphaSimR_mergeGeno(SEXP xSEXP, SEXP ySEXP) {
-BEGIN_RCPP
-    Rcpp::RObject rcpp_result_gen;
-    Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type x(xSEXP);
-    Rcpp::traits::input_parameter< const arma::field<arma::Cube<unsigned char> >& >::type y(ySEXP);
-    rcpp_result_gen = Rcpp::wrap(mergeGeno(x, y));
-    return rcpp_result_gen;
-END_RCPP
-}
-// mergeMultGeno
-arma::field<arma::Cube<unsigned char> > mergeMultGeno(Rcpp::List& popList, arma::uvec nInd, arma::uvec nBin, arma::uword ploidy);
-RcppExport SEXP _AlphaSimR_mergeMultGeno(SEXP popListSEXP, SEXP nIndSEXP, SEXP nBinSEXP, SEXP ploidySEXP) {
-BEGIN_RCPP
-    Rcpp::RObject rcpp_result_gen;
-    Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Rcpp::List& >::type popList(popListSEXP);
-    Rcpp::traits::input_parameter< arma::uvec >::type nInd(nIndSEXP);
-    Rcpp::traits::input_parameter< arma::uvec >::type nBin(nBinSEXP);
-    Rcpp::traits::input_parameter< arma::uword >::type ploidy(ploidySEXP);
-    rcpp_result_gen = Rcpp::wrap(mergeMultGeno(popList, nInd, nBin, ploidy));
-    return rcpp_result_gen;
-END_RCPP
-}
 // mergeMultIntMat
 arma::Mat<int> mergeMultIntMat(const arma::field<arma::Mat<int> >& X, arma::uvec nRow, arma::uword nCol);
 RcppExport SEXP _AlphaSimR_mergeMultIntMat(SEXP XSEXP, SEXP nRowSEXP, SEXP nColSEXP) {
@@ -816,31 +1003,145 @@ BEGIN_RCPP
 END_RCPP
 }
 // packHaplo
-arma::Cube<unsigned char> packHaplo(arma::Mat<unsigned char>& haplo, arma::uword ploidy, bool inbred);
-RcppExport SEXP _AlphaSimR_packHaplo(SEXP haploSEXP, SEXP ploidySEXP, SEXP inbredSEXP) {
+Rcpp::List packHaplo(Rcpp::List haplotypes, arma::uword ploidy, bool inbred, int nThreads);
+RcppExport SEXP _AlphaSimR_packHaplo(SEXP haplotypesSEXP, SEXP ploidySEXP, SEXP inbredSEXP, SEXP nThreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< arma::Mat<unsigned char>& >::type haplo(haploSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type haplotypes(haplotypesSEXP);
     Rcpp::traits::input_parameter< arma::uword >::type ploidy(ploidySEXP);
     Rcpp::traits::input_parameter< bool >::type inbred(inbredSEXP);
-    rcpp_result_gen = Rcpp::wrap(packHaplo(haplo, ploidy, inbred));
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(packHaplo(haplotypes, ploidy, inbred, nThreads));
     return rcpp_result_gen;
 END_RCPP
 }
-// MaCS
-Rcpp::List MaCS(Rcpp::String args, arma::uvec maxSites, bool inbred, arma::uword ploidy, int nThreads, Rcpp::StringVector seed);
-RcppExport SEXP _AlphaSimR_MaCS(SEXP argsSEXP, SEXP maxSitesSEXP, SEXP inbredSEXP, SEXP ploidySEXP, SEXP nThreadsSEXP, SEXP seedSEXP) {
+// pbwtCompress
+Rcpp::List pbwtCompress(SEXP geno, arma::uvec nLoci, int blockSize, int nThreads);
+RcppExport SEXP _AlphaSimR_pbwtCompress(SEXP genoSEXP, SEXP nLociSEXP, SEXP blockSizeSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type geno(genoSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type nLoci(nLociSEXP);
+    Rcpp::traits::input_parameter< int >::type blockSize(blockSizeSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(pbwtCompress(geno, nLoci, blockSize, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pbwtGeno
+arma::Mat<unsigned char> pbwtGeno(Rcpp::List pbwt, arma::uword nInd, arma::uword ploidy, int blockSize, const arma::Col<int>& lociPerChr, arma::uvec lociLoc, int nThreads);
+RcppExport SEXP _AlphaSimR_pbwtGeno(SEXP pbwtSEXP, SEXP nIndSEXP, SEXP ploidySEXP, SEXP blockSizeSEXP, SEXP lociPerChrSEXP, SEXP lociLocSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type pbwt(pbwtSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type nInd(nIndSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type ploidy(ploidySEXP);
+    Rcpp::traits::input_parameter< int >::type blockSize(blockSizeSEXP);
+    Rcpp::traits::input_parameter< const arma::Col<int>& >::type lociPerChr(lociPerChrSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type lociLoc(lociLocSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(pbwtGeno(pbwt, nInd, ploidy, blockSize, lociPerChr, lociLoc, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pbwtMatch
+Rcpp::List pbwtMatch(Rcpp::List pbwt, arma::uword nHap, int blockSize, const arma::Mat<unsigned char>& query, int nThreads);
+RcppExport SEXP _AlphaSimR_pbwtMatch(SEXP pbwtSEXP, SEXP nHapSEXP, SEXP blockSizeSEXP, SEXP querySEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type pbwt(pbwtSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type nHap(nHapSEXP);
+    Rcpp::traits::input_parameter< int >::type blockSize(blockSizeSEXP);
+    Rcpp::traits::input_parameter< const arma::Mat<unsigned char>& >::type query(querySEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(pbwtMatch(pbwt, nHap, blockSize, query, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// predictCrossGv
+Rcpp::List predictCrossGv(const Rcpp::S4& trait, const Rcpp::S4& pop, arma::uvec mother, arma::uvec father, Rcpp::List femaleMap, Rcpp::List maleMap, bool haldane, int nThreads);
+RcppExport SEXP _AlphaSimR_predictCrossGv(SEXP traitSEXP, SEXP popSEXP, SEXP motherSEXP, SEXP fatherSEXP, SEXP femaleMapSEXP, SEXP maleMapSEXP, SEXP haldaneSEXP, SEXP nThreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type trait(traitSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type pop(popSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type mother(motherSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type father(fatherSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type femaleMap(femaleMapSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type maleMap(maleMapSEXP);
+    Rcpp::traits::input_parameter< bool >::type haldane(haldaneSEXP);
+    Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(predictCrossGv(trait, pop, mother, father, femaleMap, maleMap, haldane, nThreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MaCSConfig
+SEXP MaCSConfig(Rcpp::String args, bool hudson);
+RcppExport SEXP _AlphaSimR_MaCSConfig(SEXP argsSEXP, SEXP hudsonSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::String >::type args(argsSEXP);
+    Rcpp::traits::input_parameter< bool >::type hudson(hudsonSEXP);
+    rcpp_result_gen = Rcpp::wrap(MaCSConfig(args, hudson));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MaCS
+Rcpp::List MaCS(SEXP config, arma::uvec maxSites, bool inbred, arma::uword ploidy, int nThreads, arma::uvec seed, bool hudson);
+RcppExport SEXP _AlphaSimR_MaCS(SEXP configSEXP, SEXP maxSitesSEXP, SEXP inbredSEXP, SEXP ploidySEXP, SEXP nThreadsSEXP, SEXP seedSEXP, SEXP hudsonSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type config(configSEXP);
     Rcpp::traits::input_parameter< arma::uvec >::type maxSites(maxSitesSEXP);
     Rcpp::traits::input_parameter< bool >::type inbred(inbredSEXP);
     Rcpp::traits::input_parameter< arma::uword >::type ploidy(ploidySEXP);
     Rcpp::traits::input_parameter< int >::type nThreads(nThreadsSEXP);
-    Rcpp::traits::input_parameter< Rcpp::StringVector >::type seed(seedSEXP);
-    rcpp_result_gen = Rcpp::wrap(MaCS(args, maxSites, inbred, ploidy, nThreads, seed));
+    Rcpp::traits::input_parameter< arma::uvec >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< bool >::type hudson(hudsonSEXP);
+    rcpp_result_gen = Rcpp::wrap(MaCS(config, maxSites, inbred, ploidy, nThreads, seed, hudson));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MaCSTreeSeq
+Rcpp::List MaCSTreeSeq(Rcpp::String args);
+RcppExport SEXP _AlphaSimR_MaCSTreeSeq(SEXP argsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::String >::type args(argsSEXP);
+    rcpp_result_gen = Rcpp::wrap(MaCSTreeSeq(args));
+    return rcpp_result_gen;
+END_RCPP
+}
+// MaCSHaplo
+Rcpp::List MaCSHaplo(Rcpp::String args);
+RcppExport SEXP _AlphaSimR_MaCSHaplo(SEXP argsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::String >::type args(argsSEXP);
+    rcpp_result_gen = Rcpp::wrap(MaCSHaplo(args));
+    return rcpp_result_gen;
+END_RCPP
+}
+// decodeTreeSeq
+arma::Cube<unsigned char> decodeTreeSeq(Rcpp::List treeSeqList, arma::uvec sites, arma::uword ploidy, bool inbred);
+RcppExport SEXP _AlphaSimR_decodeTreeSeq(SEXP treeSeqListSEXP, SEXP sitesSEXP, SEXP ploidySEXP, SEXP inbredSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type treeSeqList(treeSeqListSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type sites(sitesSEXP);
+    Rcpp::traits::input_parameter< arma::uword >::type ploidy(ploidySEXP);
+    Rcpp::traits::input_parameter< bool >::type inbred(inbredSEXP);
+    rcpp_result_gen = Rcpp::wrap(decodeTreeSeq(treeSeqList, sites, ploidy, inbred));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -865,12 +1166,19 @@ static const R_CallMethodDef CallEntries[] = {
     {"_AlphaSimR_solveUVM", (DL_FUNC) &_AlphaSimR_solveUVM, 4},
     {"_AlphaSimR_solveMVM", (DL_FUNC) &_AlphaSimR_solveMVM, 6},
     {"_AlphaSimR_solveMKM", (DL_FUNC) &_AlphaSimR_solveMKM, 6},
-    {"_AlphaSimR_writeASGenotypes", (DL_FUNC) &_AlphaSimR_writeASGenotypes, 7},
-    {"_AlphaSimR_writeASHaplotypes", (DL_FUNC) &_AlphaSimR_writeASHaplotypes, 7},
-    {"_AlphaSimR_argAltAD", (DL_FUNC) &_AlphaSimR_argAltAD, 7},
-    {"_AlphaSimR_objAltAD", (DL_FUNC) &_AlphaSimR_objAltAD, 2},
-    {"_AlphaSimR_finAltAD", (DL_FUNC) &_AlphaSimR_finAltAD, 2},
+    {"_AlphaSimR_callGWAS", (DL_FUNC) &_AlphaSimR_callGWAS, 7},
+    {"_AlphaSimR_writeASGenotypes", (DL_FUNC) &_AlphaSimR_writeASGenotypes, 8},
+    {"_AlphaSimR_writeASHaplotypes", (DL_FUNC) &_AlphaSimR_writeASHaplotypes, 8},
+    {"_AlphaSimR_calcAltAD", (DL_FUNC) &_AlphaSimR_calcAltAD, 9},
     {"_AlphaSimR_calcGenParam", (DL_FUNC) &_AlphaSimR_calcGenParam, 3},
+    {"_AlphaSimR_calcGenoCount", (DL_FUNC) &_AlphaSimR_calcGenoCount, 3},
+    {"_AlphaSimR_calcGenicParam", (DL_FUNC) &_AlphaSimR_calcGenicParam, 3},
+    {"_AlphaSimR_calcLdWindow", (DL_FUNC) &_AlphaSimR_calcLdWindow, 5},
+    {"_AlphaSimR_calcLdPair", (DL_FUNC) &_AlphaSimR_calcLdPair, 5},
+    {"_AlphaSimR_mapGenoFile", (DL_FUNC) &_AlphaSimR_mapGenoFile, 3},
+    {"_AlphaSimR_mergeGeno", (DL_FUNC) &_AlphaSimR_mergeGeno, 2},
+    {"_AlphaSimR_mergeMultGeno", (DL_FUNC) &_AlphaSimR_mergeMultGeno, 3},
+    {"_AlphaSimR_poolGeno", (DL_FUNC) &_AlphaSimR_poolGeno, 2},
     {"_AlphaSimR_getGeno", (DL_FUNC) &_AlphaSimR_getGeno, 4},
     {"_AlphaSimR_getMaternalGeno", (DL_FUNC) &_AlphaSimR_getMaternalGeno, 4},
     {"_AlphaSimR_getPaternalGeno", (DL_FUNC) &_AlphaSimR_getPaternalGeno, 4},
@@ -879,31 +1187,46 @@ static const R_CallMethodDef CallEntries[] = {
     {"_AlphaSimR_setHaplo", (DL_FUNC) &_AlphaSimR_setHaplo, 5},
     {"_AlphaSimR_writeGeno", (DL_FUNC) &_AlphaSimR_writeGeno, 5},
     {"_AlphaSimR_writeOneHaplo", (DL_FUNC) &_AlphaSimR_writeOneHaplo, 6},
+    {"_AlphaSimR_writeRecordsBin", (DL_FUNC) &_AlphaSimR_writeRecordsBin, 8},
+    {"_AlphaSimR_readRecordsBin", (DL_FUNC) &_AlphaSimR_readRecordsBin, 4},
+    {"_AlphaSimR_writeBed", (DL_FUNC) &_AlphaSimR_writeBed, 5},
     {"_AlphaSimR_calcGenoFreq", (DL_FUNC) &_AlphaSimR_calcGenoFreq, 4},
-    {"_AlphaSimR_calcChrFreq", (DL_FUNC) &_AlphaSimR_calcChrFreq, 1},
+    {"_AlphaSimR_calcAlleleFreq", (DL_FUNC) &_AlphaSimR_calcAlleleFreq, 2},
     {"_AlphaSimR_getGv", (DL_FUNC) &_AlphaSimR_getGv, 3},
+    {"_AlphaSimR_getGvMulti", (DL_FUNC) &_AlphaSimR_getGvMulti, 3},
     {"_AlphaSimR_getHybridGv", (DL_FUNC) &_AlphaSimR_getHybridGv, 6},
+    {"_AlphaSimR_getHybridGvFactorial", (DL_FUNC) &_AlphaSimR_getHybridGvFactorial, 4},
     {"_AlphaSimR_getNonFounderIbd", (DL_FUNC) &_AlphaSimR_getNonFounderIbd, 3},
     {"_AlphaSimR_getFounderIbd", (DL_FUNC) &_AlphaSimR_getFounderIbd, 2},
     {"_AlphaSimR_createIbdMat", (DL_FUNC) &_AlphaSimR_createIbdMat, 5},
+    {"_AlphaSimR_readVcf", (DL_FUNC) &_AlphaSimR_readVcf, 6},
     {"_AlphaSimR_cross", (DL_FUNC) &_AlphaSimR_cross, 15},
+    {"_AlphaSimR_forwardSim", (DL_FUNC) &_AlphaSimR_forwardSim, 11},
     {"_AlphaSimR_createDH2", (DL_FUNC) &_AlphaSimR_createDH2, 7},
     {"_AlphaSimR_createReducedGenome", (DL_FUNC) &_AlphaSimR_createReducedGenome, 10},
     {"_AlphaSimR_popVar", (DL_FUNC) &_AlphaSimR_popVar, 1},
-    {"_AlphaSimR_mergeGeno", (DL_FUNC) &_AlphaSimR_mergeGeno, 2},
-    {"_AlphaSimR_mergeMultGeno", (DL_FUNC) &_AlphaSimR_mergeMultGeno, 4},
     {"_AlphaSimR_mergeMultIntMat", (DL_FUNC) &_AlphaSimR_mergeMultIntMat, 3},
     {"_AlphaSimR_sampleInt", (DL_FUNC) &_AlphaSimR_sampleInt, 2},
     {"_AlphaSimR_sampAllComb", (DL_FUNC) &_AlphaSimR_sampAllComb, 3},
     {"_AlphaSimR_sampHalfDialComb", (DL_FUNC) &_AlphaSimR_sampHalfDialComb, 2},
     {"_AlphaSimR_calcCoef", (DL_FUNC) &_AlphaSimR_calcCoef, 2},
     {"_AlphaSimR_getNumThreads", (DL_FUNC) &_AlphaSimR_getNumThreads, 0},
-    {"_AlphaSimR_packHaplo", (DL_FUNC) &_AlphaSimR_packHaplo, 3},
-    {"_AlphaSimR_MaCS", (DL_FUNC) &_AlphaSimR_MaCS, 6},
+    {"_AlphaSimR_packHaplo", (DL_FUNC) &_AlphaSimR_packHaplo, 4},
+    {"_AlphaSimR_pbwtCompress", (DL_FUNC) &_AlphaSimR_pbwtCompress, 4},
+    {"_AlphaSimR_pbwtGeno", (DL_FUNC) &_AlphaSimR_pbwtGeno, 7},
+    {"_AlphaSimR_pbwtMatch", (DL_FUNC) &_AlphaSimR_pbwtMatch, 5},
+    {"_AlphaSimR_predictCrossGv", (DL_FUNC) &_AlphaSimR_predictCrossGv, 8},
+    {"_AlphaSimR_MaCSConfig", (DL_FUNC) &_AlphaSimR_MaCSConfig, 2},
+    {"_AlphaSimR_MaCS", (DL_FUNC) &_AlphaSimR_MaCS, 7},
+    {"_AlphaSimR_MaCSTreeSeq", (DL_FUNC) &_AlphaSimR_MaCSTreeSeq, 1},
+    {"_AlphaSimR_MaCSHaplo", (DL_FUNC) &_AlphaSimR_MaCSHaplo, 1},
+    {"_AlphaSimR_decodeTreeSeq", (DL_FUNC) &_AlphaSimR_decodeTreeSeq, 4},
     {NULL, NULL, 0}
 };
 
+void registerGenoStore(DllInfo* dll);
 RcppExport void R_init_AlphaSimR(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    registerGenoStore(dll);
 }
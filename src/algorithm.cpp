@@ -1109,19 +1109,27 @@ void GraphBuilder::addMutations(double startPos,double endPos){
       double dMutationTime=-1.;
       EdgePtr selectedEdge = getRandomEdgeOnTree(dMutationTime,dRandomSpot);
       //Rcpp::Rcerr<<"Mutation time is "<<dMutationTime<<endl;
-      mutateBelowEdge(selectedEdge);
-      // NodePtrVector::iterator it;
-      
-      unique_ptr<AlphaSimRReturn> temp(new AlphaSimRReturn());
-      temp->length = startPos;
       unsigned int iSampleSize = pConfig->iSampleSize;
-      for (unsigned int iSampleIndex=0;iSampleIndex<iSampleSize;++iSampleIndex){
-        SampleNode * sample = static_cast<SampleNode*>(pSampleNodeArray[iSampleIndex].get());
-        sites[iSampleIndex]=sample->bAffected;
-        temp->haplotypes.push_back(sample->bAffected);
-        sample->bAffected=false;
+      if (pTreeSeq!=NULL){
+        // the local tree is already recorded, so only the
+        // node below the mutation needs to be stored
+        pTreeSeq->addSite(startPos,
+                          getTreeSeqId(selectedEdge->getBottomNodeRef()));
+      }
+      if (pTreeSeq==NULL || pConfig->bSNPAscertainment){
+        mutateBelowEdge(selectedEdge);
+        // NodePtrVector::iterator it;
+        
+        unique_ptr<AlphaSimRReturn> temp(new AlphaSimRReturn());
+        temp->length = startPos;
+        for (unsigned int iSampleIndex=0;iSampleIndex<iSampleSize;++iSampleIndex){
+          SampleNode * sample = static_cast<SampleNode*>(pSampleNodeArray[iSampleIndex].get());
+          sites[iSampleIndex]=sample->bAffected;
+          if (pTreeSeq==NULL) temp->haplotypes.push_back(sample->bAffected);
+          sample->bAffected=false;
+        }
+        if (pTreeSeq==NULL) mutations.push_back(*temp);
       }
-      mutations.push_back(*temp);
       double dFreq=0.;
       if (pConfig->bSNPAscertainment){
         // first compute the MAF
@@ -1297,6 +1305,9 @@ void GraphBuilder::build(){
     // check if there was an existing gene conversion event that needs
     // to be closed. backtrack if necessary.
     this->bEndGeneConversion  = checkPendingGeneConversions(curPos);
+    if (pTreeSeq!=NULL && curPos>lastPos){
+      recordTree(lastPos,curPos);
+    }
     if (pConfig->dTheta>0.0){
       addMutations(lastPos,curPos);
     }
@@ -1310,3 +1321,32 @@ vector<AlphaSimRReturn> GraphBuilder::getMutations() {
   return mutations;
 }
 
+int GraphBuilder::getTreeSeqId(NodePtr & node){
+  if (node->iTreeSeqId<0){
+    node->iTreeSeqId = pTreeSeq->addNode(node->getHeight());
+  }
+  return node->iTreeSeqId;
+}
+
+void GraphBuilder::recordTree(double startPos,double endPos){
+  if (pTreeSeq->nodeTime.empty()){
+    // sample nodes occupy the first rows of the node table
+    pTreeSeq->iSampleSize = pConfig->iSampleSize;
+    for (unsigned int i=0;i<pConfig->iSampleSize;++i){
+      getTreeSeqId(pSampleNodeArray[i]);
+    }
+  }
+  vector<pair<int,int> > treeEdges;
+  treeEdges.reserve(iTotalTreeEdges);
+  EdgePtrVector::iterator it = pEdgeVectorInTree->begin();
+  for (unsigned int counter=0;counter<iTotalTreeEdges;++counter,++it){
+    EdgePtr curEdge = *it;
+    if (!curEdge->bDeleted){
+      treeEdges.push_back(make_pair(
+          getTreeSeqId(curEdge->getTopNodeRef()),
+          getTreeSeqId(curEdge->getBottomNodeRef())));
+    }
+  }
+  pTreeSeq->addTree(startPos,endPos,treeEdges);
+}
+
@@ -2,61 +2,102 @@
 #include <iostream>
 #include <fstream>
 
+// Row of g written for each column of the output, or -1 for loci that
+// are not on the SNP chip and are written as missing
+std::vector<long> chipColumns(const arma::field<arma::uvec> &locations,
+                              const arma::uvec &allLocations,
+                              arma::uword chip){
+  std::vector<long> output(allLocations.n_elem, -1);
+  if (chip == 0) {
+    for (arma::uword k = 0; k < allLocations.n_elem; k++) {
+      output[k] = allLocations(k) - 1;
+    }
+  }
+  else {
+    const arma::uvec & chipLoc = locations(chip - 1);
+    arma::uword cur = 0;
+    for (arma::uword k = 0; k < allLocations.n_elem; k++) {
+      if ( (cur < chipLoc.n_elem) && (allLocations(k) == chipLoc(cur)) ){
+        output[k] = chipLoc(cur) - 1;
+        cur ++;
+      }
+    }
+  }
+  return output;
+}
+
+// Appends a line with the name followed by the values of the selected
+// rows, summing the rows of hap0 and hap1 if hap1 is not NULL
+void appendASRow(std::string & out,
+                 const std::string & name,
+                 const unsigned char * hap0,
+                 const unsigned char * hap1,
+                 const std::vector<long> & columns,
+                 const char missing){
+  out.reserve(out.size() + name.size() + 2*columns.size() + 1);
+  out += name;
+  for (arma::uword k = 0; k < columns.size(); k++) {
+    out += ' ';
+    if (columns[k] < 0) {
+      out += missing;
+    }
+    else {
+      unsigned char value = hap0[columns[k]];
+      if (hap1 != NULL) {
+        value += hap1[columns[k]];
+      }
+      out += char(value + 48);
+    }
+  }
+  out += '\n';
+}
+
+// Rows are formatted in parallel, one block of individuals at a time,
+// and each block is written with sequential writes. These functions are
+// called directly from R, so nThreads less than 1 uses all available
+// threads as detected by getNumThreads().
 // [[Rcpp::export]]
 void writeASGenotypes(const arma::Cube<unsigned char> & g,
                       const arma::field<arma::uvec> &locations,
                       const arma::uvec &allLocations,
-                      const arma::vec & snpchips, 
-                      const std::vector<std::string> & names, 
+                      const arma::vec & snpchips,
+                      const std::vector<std::string> & names,
                       const char missing,
-                      const std::string fname){
-  
+                      const std::string fname,
+                      int nThreads=0){
+  if (nThreads < 1) {
+    nThreads = getNumThreads();
+  }
+
   std::ofstream ASout;
   ASout.open(fname, std::ios::trunc);
 
-  char name[20];
-  for (arma::uword i = 0; i < snpchips.n_rows; i++){
-    arma::Col<unsigned char> all0 = g.slice(i).col(0);
-    arma::Col<unsigned char> all1 = g.slice(i).col(1);
-    arma::Col<unsigned char> selected0;
-    arma::Col<unsigned char> selected1;
-    
-    if (snpchips(i) == 0) {
-      selected0 = all0.elem(allLocations - 1);
-      selected1 = all1.elem(allLocations - 1);      
-    }
-    else{
-      selected0 = all0.elem(locations(snpchips(i) - 1) - 1);
-      selected1 = all1.elem(locations(snpchips(i) - 1) - 1);
-    }
-    
-    arma::Col<unsigned char> selectedg = selected0 + selected1;
-    
-    std::snprintf(name,0,"%s",names[i].c_str());
-    ASout << name;
-    
-    if (snpchips(i) == 0) {
-      for (arma::uword k = 0; k < allLocations.n_rows; k++) {
-        ASout << " " << char(selectedg(k) + 48);
-      }      
+  // Output columns of each SNP chip, computed once
+  std::vector<std::vector<long> > columns(locations.n_elem + 1);
+  for (arma::uword chip = 0; chip <= locations.n_elem; chip++) {
+    columns[chip] = chipColumns(locations, allLocations, chip);
+  }
+
+  arma::uword nInd = snpchips.n_rows;
+  arma::uword blockSize = 1024;
+  std::vector<std::string> rows(blockSize);
+  for (arma::uword start = 0; start < nInd; start += blockSize) {
+    arma::uword n = std::min(blockSize, nInd - start);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for (arma::uword r = 0; r < n; r++) {
+      arma::uword i = start + r;
+      rows[r].clear();
+      appendASRow(rows[r], names[i], g.slice_colptr(i, 0),
+                  g.slice_colptr(i, 1),
+                  columns[arma::uword(snpchips(i))], missing);
     }
-    else
-    {
-      arma::uword cur = 0;
-      for (arma::uword k = 0; k < allLocations.n_rows; k++) {
-        if ( (cur < locations(snpchips(i) - 1).n_rows) && ((allLocations(k) - 1) == (locations(snpchips(i) - 1)(cur) - 1)) ){
-          ASout << " " << char(selectedg(cur) + 48);
-          cur ++;
-        }
-        else {
-          ASout << " " << missing;
-        }
-      }
+    for (arma::uword r = 0; r < n; r++) {
+      ASout.write(rows[r].data(), rows[r].size());
     }
-    
-    ASout << "\n";
   }
-  
+
   ASout.close();
 }
 
@@ -64,45 +105,45 @@ void writeASGenotypes(const arma::Cube<unsigned char> & g,
 void writeASHaplotypes(const arma::Cube<unsigned char> & g,
                       const arma::field<arma::uvec> &locations,
                       const arma::uvec &allLocations,
-                      const arma::vec & snpchips, 
+                      const arma::vec & snpchips,
                       const std::vector<std::string> & names,
                       const char missing,
-                      const std::string fname){
-  
+                      const std::string fname,
+                      int nThreads=0){
+  if (nThreads < 1) {
+    nThreads = getNumThreads();
+  }
+
   std::ofstream ASout;
   ASout.open(fname, std::ios::trunc);
-  
-  char name[20];
-  for (arma::uword i = 0; i < snpchips.n_rows; i++){
-    for (arma::uword j = 0; j < 2; j ++){
-      arma::Col<unsigned char> all = g.slice(i).col(j);
 
-      std::snprintf(name,0,"%s",names[i].c_str());
-      ASout << name;
+  // Output columns of each SNP chip, computed once
+  std::vector<std::vector<long> > columns(locations.n_elem + 1);
+  for (arma::uword chip = 0; chip <= locations.n_elem; chip++) {
+    columns[chip] = chipColumns(locations, allLocations, chip);
+  }
 
-      if (snpchips(i) == 0) {
-        arma::Col<unsigned char> selected = all.elem(allLocations - 1);
-        for (arma::uword k = 0; k < allLocations.n_rows; k++) {
-          ASout << " " << char(selected(k) + 48);
-        }      
-      }
-      else {
-        arma::uword cur = 0;
-        for (arma::uword k = 0; k < allLocations.n_rows; k++) {
-          arma::Col<unsigned char> selected = all.elem(locations(snpchips(i) - 1) - 1);
-          if ( (cur < locations(snpchips(i) - 1).n_rows) && ((allLocations(k) - 1) == (locations(snpchips(i) - 1)(cur) - 1)) ){
-            ASout << " " << char(selected(cur) + 48);
-            cur ++;
-          }
-          else {
-            ASout << " " << missing;
-          }
-        }
+  arma::uword nInd = snpchips.n_rows;
+  arma::uword blockSize = 1024;
+  std::vector<std::string> rows(blockSize);
+  for (arma::uword start = 0; start < nInd; start += blockSize) {
+    arma::uword n = std::min(blockSize, nInd - start);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for (arma::uword r = 0; r < n; r++) {
+      arma::uword i = start + r;
+      const std::vector<long> & chipCols = columns[arma::uword(snpchips(i))];
+      rows[r].clear();
+      for (arma::uword j = 0; j < 2; j ++){
+        appendASRow(rows[r], names[i], g.slice_colptr(i, j), NULL,
+                    chipCols, missing);
       }
-      
-      ASout << "\n";
+    }
+    for (arma::uword r = 0; r < n; r++) {
+      ASout.write(rows[r].data(), rows[r].size());
     }
   }
-  
+
   ASout.close();
-}
\ No newline at end of file
+}
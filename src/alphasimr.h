@@ -4,6 +4,7 @@
 #include <RcppArmadillo.h>
 #include <bitset>
 #include "getGeno.h"
+#include "epistasis.h"
 #include "optimize.h"
 #include "misc.h"
 #ifdef _OPENMP
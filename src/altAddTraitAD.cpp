@@ -1,15 +1,132 @@
 #include "alphasimr.h"
 
-// Sets up the list of arguments needed for optimization
+// Individuals per block when accumulating values for individuals
+const arma::uword indBlock = 256;
+
+// Sufficient statistics for altAddTraitAD
+// Dominance effects are d = meanDD*u + stdDevDD*v, where u=abs(a) and
+// v=abs(a)%domDegDev. Breeding values and dominance deviations of
+// individuals are linear in meanDD and stdDevDD:
+//   bv = b0 + meanDD*b1 + stdDevDD*b2
+//   dd = meanDD*r1 + stdDevDD*r2
+// so variances come from the cross-products (G) of these vectors.
+struct AltADStats{
+  arma::mat G; // Cross-products of b0, b1, b2, r1 and r2 divided by nInd
+  double hetU, hetV; // Inbreeding depression for u and v
+  double muA, muU, muV; // Mean genetic value for a, u and v
+};
+
+// Quadratic form of G with weights for b0, b1, b2, r1 and r2
+inline double altADVar(const AltADStats& stats, double w0, double w1,
+                       double w2, double w3, double w4){
+  double w[5] = {w0, w1, w2, w3, w4};
+  double output = 0;
+  for(arma::uword i=0; i<5; ++i){
+    for(arma::uword j=0; j<5; ++j){
+      output += w[i]*w[j]*stats.G(i,j);
+    }
+  }
+  return output;
+}
+
+// Distance between target and observed inbreeding depression and
+// dominance variance (as standard deviation), after scaling effects
+// to hit the target additive variance
+double objAltAD(const AltADStats& stats, double meanDD, double stdDevDD,
+                double varA, double varD, double inbrDepr){
+  double obsVarA = altADVar(stats, 1, meanDD, stdDevDD, 0, 0);
+  double obsVarD = altADVar(stats, 0, 0, 0, meanDD, stdDevDD);
+  double scale = sqrt(varA) / sqrt(obsVarA);
+  obsVarD *= scale*scale;
+  double obsInbrDepr = scale*(meanDD*stats.hetU + stdDevDD*stats.hetV);
+  return sqrt(std::pow(obsInbrDepr-inbrDepr, 2) +
+              std::pow(sqrt(obsVarD)-sqrt(varD), 2));
+}
+
+// Moves a point inside bounds
+inline arma::vec clampPar(arma::vec par, const arma::vec& lower,
+                          const arma::vec& upper){
+  for(arma::uword i=0; i<par.n_elem; ++i){
+    par(i) = std::min(std::max(par(i), lower(i)), upper(i));
+  }
+  return par;
+}
+
+// Nelder-Mead search for meanDD and stdDevDD within bounds. Points
+// outside the bounds are moved to the nearest bound.
+arma::vec optAltAD(const AltADStats& stats, const arma::vec& lower,
+                   const arma::vec& upper, double varA, double varD,
+                   double inbrDepr, int maxIter=1000, double eps=1.0e-10){
+  arma::mat simplex(2,3);
+  arma::vec f(3);
+  simplex.col(0) = (lower+upper)/2.0;
+  simplex.col(1) = simplex.col(0);
+  simplex.col(2) = simplex.col(0);
+  simplex(0,1) += (upper(0)-lower(0))/4.0;
+  simplex(1,2) += (upper(1)-lower(1))/4.0;
+  for(arma::uword i=0; i<3; ++i){
+    f(i) = objAltAD(stats, simplex(0,i), simplex(1,i), varA, varD, inbrDepr);
+  }
+  for(int iter=0; iter<maxIter; ++iter){
+    arma::uvec ord = arma::sort_index(f);
+    simplex = simplex.cols(ord);
+    f = f(ord);
+    if((f(2)-f(0))<=(eps*(std::abs(f(0))+eps))){
+      break;
+    }
+    arma::vec centroid = (simplex.col(0)+simplex.col(1))/2.0;
+    // Reflection
+    arma::vec xr = clampPar(2.0*centroid-simplex.col(2), lower, upper);
+    double fr = objAltAD(stats, xr(0), xr(1), varA, varD, inbrDepr);
+    if(fr<f(0)){
+      // Expansion
+      arma::vec xe = clampPar(3.0*centroid-2.0*simplex.col(2), lower, upper);
+      double fe = objAltAD(stats, xe(0), xe(1), varA, varD, inbrDepr);
+      if(fe<fr){
+        simplex.col(2) = xe;
+        f(2) = fe;
+      }else{
+        simplex.col(2) = xr;
+        f(2) = fr;
+      }
+    }else if(fr<f(1)){
+      simplex.col(2) = xr;
+      f(2) = fr;
+    }else{
+      // Contraction
+      arma::vec xc = (centroid+simplex.col(2))/2.0;
+      double fc = objAltAD(stats, xc(0), xc(1), varA, varD, inbrDepr);
+      if(fc<f(2)){
+        simplex.col(2) = xc;
+        f(2) = fc;
+      }else{
+        // Shrink towards the best point
+        for(arma::uword i=1; i<3; ++i){
+          simplex.col(i) = (simplex.col(0)+simplex.col(i))/2.0;
+          f(i) = objAltAD(stats, simplex(0,i), simplex(1,i),
+                          varA, varD, inbrDepr);
+        }
+      }
+    }
+  }
+  return simplex.col(f.index_min());
+}
+
+// Finds dominance degree parameters matching the desired dominance
+// variance and inbreeding depression and returns the trait's effects.
+// Genotypes are read once to calculate sufficient statistics, so each
+// evaluation of the objective doesn't depend on nInd or nLoci.
 // [[Rcpp::export]]
-Rcpp::List argAltAD(Rcpp::S4 LociMap,
-                    Rcpp::S4 Pop,
-                    double mean,
-                    double varA,
-                    double varD,
-                    double inbrDepr,
-                    int nThreads){
-  
+Rcpp::List calcAltAD(Rcpp::S4 LociMap,
+                     Rcpp::S4 Pop,
+                     double mean,
+                     double varA,
+                     double varD,
+                     double inbrDepr,
+                     arma::vec limMeanDD,
+                     arma::vec limVarDD,
+                     int nThreads){
+
   // Create ploidy specific genotype dosage variables
   arma::uword ploidy = Pop.slot("ploidy");
   double dP = double(ploidy);
@@ -19,267 +136,121 @@ Rcpp::List argAltAD(Rcpp::S4 LociMap,
     x(i) = double(i);
   arma::vec xa = (x-dP/2.0)*(2.0/dP);
   arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
-  
+
   // Extract loci information and genotypes
   const arma::Col<int>& lociPerChr = LociMap.slot("lociPerChr");
   arma::uword nLoci = accu(lociPerChr);
   arma::uvec lociLoc = LociMap.slot("lociLoc");
   arma::Mat<unsigned char> genoMat = getGeno(
-    Rcpp::as<arma::field<arma::Cube<unsigned char> > >(Pop.slot("geno")), 
-    lociPerChr, 
-    lociLoc, 
+    GenoView(SEXP(Pop.slot("geno"))),
+    lociPerChr,
+    lociLoc,
     nThreads
   );
-  
-  // Calculate genotype frequencies
-  arma::mat genoFreq(ploidy+1, nLoci, arma::fill::zeros);
-  arma::vec genoMu(nLoci), hetHWE(nLoci);
+
+  // Sample random deviates
+  arma::vec a(nLoci, arma::fill::randn);
+  arma::vec domDegDev(nLoci, arma::fill::randn);
+  arma::vec u = abs(a);
+  arma::vec v = u%domDegDev;
+
+  // Values of b0, b1, b2, r1 and r2 for each dosage at each locus
+  arma::cube tab(ploidy+1, 5, nLoci);
+  arma::vec hetHWE(nLoci,arma::fill::zeros), muXa(nLoci), muXd(nLoci);
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static) num_threads(nThreads)
 #endif
   for(arma::uword i=0; i<nLoci; ++i){
-    // Count genotypes
+    // Genotype frequencies
+    arma::vec genoFreq(ploidy+1, arma::fill::zeros);
     for(arma::uword j=0; j<nInd; ++j){
-      ++genoFreq(genoMat(j,i), i);
+      ++genoFreq(genoMat(j,i));
     }
-    
-    // Convert to frequency
-    genoFreq.col(i) = genoFreq.col(i)/double(nInd);
-    
-    // Calculate genotype mean
-    genoMu(i) = accu(genoFreq.col(i)%x);
-    
-    // Calculate inbreeding depression value
-    double p = genoMu(i)/dP;
-    double q = 1-p;
+    genoFreq = genoFreq/double(nInd);
+    double genoMu = accu(genoFreq%x);
+    muXa(i) = accu(genoFreq%xa);
+    muXd(i) = accu(genoFreq%xd);
+
     // Expected heterozygosity at HWE
     // Not looping over first and last genotypes, because xd will be 0
+    double p = genoMu/dP;
+    double q = 1-p;
     for(arma::uword k=1; k<(ploidy); ++k){
       double dK = double(k);
       hetHWE(i) += xd(k)*choose(dP,dK)*std::pow(p,dK)*std::pow(q,dP-dK);
     }
-  }
-  
-  // Sample random deviates
-  arma::vec a(nLoci, arma::fill::randn);
-  arma::vec domDegDev(nLoci, arma::fill::randn);
-  
-  return Rcpp::List::create(Rcpp::Named("x")=x,
-                            Rcpp::Named("xa")=xa,
-                            Rcpp::Named("xd")=xd,
-                            Rcpp::Named("genoMat")=genoMat,
-                            Rcpp::Named("genoFreq")=genoFreq,
-                            Rcpp::Named("genoMu")=genoMu,
-                            Rcpp::Named("hetHWE")=hetHWE,
-                            Rcpp::Named("a")=a,
-                            Rcpp::Named("domDegDev")=domDegDev,
-                            Rcpp::Named("mean")=mean,
-                            Rcpp::Named("varA")=varA,
-                            Rcpp::Named("varD")=varD,
-                            Rcpp::Named("inbrDepr")=inbrDepr,
-                            Rcpp::Named("nThreads")=nThreads);
-}
 
-// The objective function for optimization
-// [[Rcpp::export]]
-double objAltAD(arma::vec input, const Rcpp::List& args){
-  // Assign new values of meanDD and stdDevDD
-  double meanDD = input(0);
-  double stdDevDD = input(1);
-  
-  // Access variables from args
-  const arma::Mat<unsigned char>& genoMat = args["genoMat"];
-  arma::uword nInd = genoMat.n_rows;
-  arma::uword nLoci = genoMat.n_cols;
-  const arma::mat& genoFreq = args["genoFreq"];
-  const arma::vec& a = args["a"];
-  const arma::vec& domDegDev = args["domDegDev"];
-  const arma::vec& x = args["x"];
-  const arma::vec& xa = args["xa"];
-  const arma::vec& xd = args["xd"];
-  const arma::vec& genoMu = args["genoMu"];
-  const arma::vec& hetHWE = args["hetHWE"];
-  double varA = args["varA"];
-  double varD = args["varD"];
-  double inbrDepr = args["inbrDepr"];
-  int nThreads = args["nThreads"];
-  
-  // Calculate d
-  arma::vec d = abs(a)%(domDegDev*stdDevDD + meanDD);
-  
-  // Allocate matrices for breeding values, dominance deviations, and means
-  // Number of threads used for efficient parallel computing
-  arma::mat bvMat(nInd, nThreads, arma::fill::zeros); // Breeding values
-  arma::mat ddMat(nInd, nThreads, arma::fill::zeros); // Dominance deviations
-  
-  // Calculate breeding values and dominance deviations
-  // Involves regressions for each locus
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) num_threads(nThreads)
-#endif
-  for(arma::uword i=0; i<nLoci; ++i){
-    
-    // Assign thread ID
-    arma::uword tid; 
-#ifdef _OPENMP
-    tid = omp_get_thread_num();
-#else
-    tid = 0;
-#endif
-    
-    // Decompose genetic values into breeding values and dominance deviations
-    arma::vec gv = xa*a(i) + xd*d(i);
-    double gvMu = accu(genoFreq.col(i)%gv); // Mean genetic value
-    gv = gv - gvMu; // Centering genetic values
-    arma::vec xc = x-genoMu(i); // Centered genotype dosage
-    
-    // Calculate average effect of an allele substitution (regression coefficient)
-    double alpha = accu(genoFreq.col(i)%gv%xc)/
-      accu(genoFreq.col(i)%xc%xc);
-    
-    // Calculate breeding values using alpha and dominance deviations using 
-    // lack-of-fit
-    arma::vec bv = xc*alpha;
-    arma::vec dd = gv - bv;
-    
-    // Fill matrices for breeding values and dominance deviations
-    // Accounts for the LD component of the variances
-    for(arma::uword j=0; j<nInd; ++j){
-      bvMat(j,tid) += bv(genoMat(j,i));
-      ddMat(j,tid) += dd(genoMat(j,i));
+    // Regression of xd on dosage gives the dominance part of the
+    // average effect. The additive part is always 2/ploidy.
+    arma::vec xc = x-genoMu; // Centered genotype dosage
+    double denom = accu(genoFreq%xc%xc);
+    double betaD = 0;
+    if(denom>0){
+      betaD = accu(genoFreq%xd%xc)/denom;
     }
+    // Dominance deviations per unit of d (lack-of-fit)
+    arma::vec r = xd - muXd(i) - xc*betaD;
+    if(denom==0){
+      xc.zeros();
+    }
+    tab.slice(i).col(0) = xc*(a(i)*2.0/dP);
+    tab.slice(i).col(1) = xc*(u(i)*betaD);
+    tab.slice(i).col(2) = xc*(v(i)*betaD);
+    tab.slice(i).col(3) = r*u(i);
+    tab.slice(i).col(4) = r*v(i);
   }
-  
-  // Calculate additive and dominance genetic variances for population
-  double obsVarA = accu(sum(bvMat,1)%sum(bvMat,1)) / nInd;
-  double obsVarD = accu(sum(ddMat,1)%sum(ddMat,1)) / nInd;
-  
-  // Scale effects to hit target additive variance
-  double scale = sqrt(varA) / sqrt(obsVarA);
-  d *= scale;
-  obsVarD *= scale*scale;
-  
-  // Calculate inbreeding depression and intercept for target mean
-  double obsInbrDepr = accu(hetHWE%d);
-  
-  // Return distance between target and observed 
-  // inbreeding depression and dominance variance (as standard deviation)
-  return sqrt(std::pow(obsInbrDepr-inbrDepr, 2) +
-              std::pow(sqrt(obsVarD)-sqrt(varD), 2));
-}
 
-// Calculates the a and d effects and the intercept
-// [[Rcpp::export]]
-Rcpp::List finAltAD(arma::vec input, const Rcpp::List& args){
-  // Assign new values of meanDD and stdDevDD
-  double meanDD = input(0);
-  double stdDevDD = input(1);
-  
-  // Access variables from args
-  const arma::Mat<unsigned char>& genoMat = args["genoMat"];
-  arma::uword nInd = genoMat.n_rows;
-  arma::uword nLoci = genoMat.n_cols;
-  const arma::mat& genoFreq = args["genoFreq"];
-  arma::vec a = args["a"];
-  const arma::vec& domDegDev = args["domDegDev"];
-  const arma::vec& x = args["x"];
-  const arma::vec& xa = args["xa"];
-  const arma::vec& xd = args["xd"];
-  const arma::vec& genoMu = args["genoMu"];
-  const arma::vec& hetHWE = args["hetHWE"];
-  double varA = args["varA"];
-  double mean = args["mean"];
-  int nThreads = args["nThreads"];
-  
-  // Calculate d
-  arma::vec d = abs(a)%(domDegDev*stdDevDD + meanDD);
-  
-  // Allocate matrices for breeding values, dominance deviations, and means
-  // Number of threads used for efficient parallel computing
-  arma::mat bvMat(nInd, nThreads, arma::fill::zeros); // Breeding values
-  arma::mat ddMat(nInd, nThreads, arma::fill::zeros); // Dominance deviations
-  
-  // Calculate breeding values and dominance deviations
-  // Involves regressions for each locus
+  // Values for individuals, accounting for the LD component of
+  // the variances
+  arma::mat B(nInd, 5, arma::fill::zeros);
+  arma::uword nBlocks = (nInd+indBlock-1)/indBlock;
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static) num_threads(nThreads)
 #endif
-  for(arma::uword i=0; i<nLoci; ++i){
-    
-    // Assign thread ID
-    arma::uword tid; 
-#ifdef _OPENMP
-    tid = omp_get_thread_num();
-#else
-    tid = 0;
-#endif
-    
-    // Decompose genetic values into breeding values and dominance deviations
-    arma::vec gv = xa*a(i) + xd*d(i);
-    double gvMu = accu(genoFreq.col(i)%gv); // Mean genetic value
-    gv = gv - gvMu; // Centering genetic values
-    arma::vec xc = x-genoMu(i); // Centered genotype dosage
-    
-    // Calculate average effect of an allele substitution (regression coefficient)
-    double alpha = accu(genoFreq.col(i)%gv%xc)/
-      accu(genoFreq.col(i)%xc%xc);
-    
-    // Calculate breeding values using alpha and dominance deviations using 
-    // lack-of-fit
-    arma::vec bv = xc*alpha;
-    arma::vec dd = gv - bv;
-    
-    // Fill matrices for breeding values and dominance deviations
-    // Accounts for the LD component of the variances
-    for(arma::uword j=0; j<nInd; ++j){
-      bvMat(j,tid) += bv(genoMat(j,i));
-      ddMat(j,tid) += dd(genoMat(j,i));
+  for(arma::uword b=0; b<nBlocks; ++b){
+    arma::uword start = b*indBlock;
+    arma::uword stop = std::min(start+indBlock,nInd);
+    for(arma::uword i=0; i<nLoci; ++i){
+      const unsigned char* dosage = genoMat.colptr(i);
+      for(arma::uword k=0; k<5; ++k){
+        const double* value = tab.slice(i).colptr(k);
+        double* out = B.colptr(k);
+        for(arma::uword j=start; j<stop; ++j){
+          out[j] += value[dosage[j]];
+        }
+      }
     }
   }
-  
-  // Calculate additive and dominance genetic variances for population
-  double obsVarA = accu(sum(bvMat,1)%sum(bvMat,1)) / nInd;
-  double obsVarD = accu(sum(ddMat,1)%sum(ddMat,1)) / nInd;
-  
+
+  AltADStats stats;
+  stats.G = B.t()*B/double(nInd);
+  stats.hetU = accu(hetHWE%u);
+  stats.hetV = accu(hetHWE%v);
+  stats.muA = accu(muXa%a);
+  stats.muU = accu(muXd%u);
+  stats.muV = accu(muXd%v);
+
+  // Optimize meanDD and stdDevDD
+  arma::vec lower = {limMeanDD(0), sqrt(limVarDD(0))};
+  arma::vec upper = {limMeanDD(1), sqrt(limVarDD(1))};
+  arma::vec par = optAltAD(stats, lower, upper, varA, varD, inbrDepr);
+  double meanDD = par(0);
+  double stdDevDD = par(1);
+
   // Scale effects to hit target additive variance
-  double scale = sqrt(varA) / sqrt(obsVarA);
+  double scale = sqrt(varA) /
+    sqrt(altADVar(stats, 1, meanDD, stdDevDD, 0, 0));
+  arma::vec d = (u*meanDD + v*stdDevDD)*scale;
   a *= scale;
-  d *= scale;
-  obsVarD *= scale*scale;
-  
-  // Calculate inbreeding depression and intercept for target mean
+  double obsVarD = altADVar(stats, 0, 0, 0, meanDD, stdDevDD)*scale*scale;
+  double obsVarG = altADVar(stats, 1, meanDD, stdDevDD, meanDD, stdDevDD)*
+    scale*scale;
   double obsInbrDepr = accu(hetHWE%d);
-  
-  // Calculate GV
-  arma::mat gvMat(nInd, nThreads, arma::fill::zeros); // Genetic values
-  
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) num_threads(nThreads)
-#endif
-  for(arma::uword i=0; i<nLoci; ++i){
-    
-    // Assign thread ID
-    arma::uword tid; 
-#ifdef _OPENMP
-    tid = omp_get_thread_num();
-#else
-    tid = 0;
-#endif
-    
-    // Decompose genetic values into breeding values and dominance deviations
-    arma::vec gv = xa*a(i) + xd*d(i);
-    
-    // Fill matrices for breeding values and dominance deviations
-    // Accounts for the LD component of the variances
-    for(arma::uword j=0; j<nInd; ++j){
-      gvMat(j,tid) += gv(genoMat(j,i));
-    }
-  }
-  
-  gvMat = sum(gvMat,1);
-  
-  double intercept = mean - accu(gvMat) / nInd;
-  
+
+  // Intercept for target mean
+  double intercept = mean -
+    scale*(stats.muA + meanDD*stats.muU + stdDevDD*stats.muV);
+
   return Rcpp::List::create(Rcpp::Named("a")=a,
                             Rcpp::Named("d")=d,
                             Rcpp::Named("intercept")=intercept,
@@ -287,5 +258,5 @@ Rcpp::List finAltAD(arma::vec input, const Rcpp::List& args){
                             Rcpp::Named("varDD")=stdDevDD*stdDevDD,
                             Rcpp::Named("inbrDepr")=obsInbrDepr,
                             Rcpp::Named("varD")=obsVarD,
-                            Rcpp::Named("varG")=accu(arma::cov(gvMat,1)));
+                            Rcpp::Named("varG")=obsVarG);
 }
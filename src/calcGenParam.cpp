@@ -1,5 +1,10 @@
 #include "alphasimr.h"
 
+// Individuals per block when accumulating values for individuals and
+// number of loci decoded at a time
+const arma::uword indBlock = 256;
+const arma::uword lociPanel = 256;
+
 // Calculates genetic parameters for traits with epistasis
 Rcpp::List calcGenParamE(const Rcpp::S4& trait, 
                          const Rcpp::S4& pop,
@@ -13,62 +18,55 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
   const arma::Col<int>& lociPerChr = trait.slot("lociPerChr");
   arma::uvec lociLoc = trait.slot("lociLoc");
   arma::vec a = trait.slot("addEff");
-  arma::mat E;
-  E = Rcpp::as<arma::mat>(trait.slot("epiEff"));
-  E.col(0) -= 1; //R to C++
-  E.col(1) -= 1; //R to C++
+  EpiLoci epi(Rcpp::as<arma::mat>(trait.slot("epiEff")), 2, ploidy);
   arma::vec d;
   double intercept = trait.slot("intercept");
-  arma::mat bvMat(nInd,nThreads,arma::fill::zeros); // "Breeding value"
-  arma::mat aaMat(nInd,nThreads,arma::fill::zeros); // Epistatic deviations
-  arma::mat gv_t; // Total genetic value
-  arma::mat gv_a(nInd,nThreads,arma::fill::zeros); // Genetic value due to a
-  arma::mat gv_aa(nInd,nThreads,arma::fill::zeros); // Genetic value due to aa
-  arma::vec genicA(nThreads,arma::fill::zeros); // No LD
-  arma::vec genicA2(nThreads,arma::fill::zeros); // No LD and HWE
-  arma::vec genicD(nThreads,arma::fill::zeros); // No LD
-  arma::vec genicD2(nThreads,arma::fill::zeros); // No LD and HWE
-  arma::vec genicAA(nThreads,arma::fill::zeros); // No LD
-  arma::vec genicAA2(nThreads,arma::fill::zeros); // No LD and HWE
-  arma::vec mu(nThreads,arma::fill::zeros); // Observed mean
-  arma::vec eMu(nThreads,arma::fill::zeros); // Expected mean with HWE
-  arma::mat ddMat, gv_d;
+  arma::uword nPairs = epi.nInt;
+  // Values by the dosages of both loci for each pair of loci
+  arma::mat bvTab(epi.nGeno,nPairs); // "Breeding value"
+  arma::mat aaTab(epi.nGeno,nPairs); // Epistatic deviations
+  arma::mat aTab(epi.nGeno,nPairs); // Genetic value due to a
+  arma::mat aaEffTab(epi.nGeno,nPairs); // Genetic value due to aa
+  arma::mat ddTab, dTab;
+  // Contributions of each pair of loci
+  arma::vec genicA(nPairs,arma::fill::zeros); // No LD
+  arma::vec genicA2(nPairs,arma::fill::zeros); // No LD and HWE
+  arma::vec genicD(nPairs,arma::fill::zeros); // No LD
+  arma::vec genicD2(nPairs,arma::fill::zeros); // No LD and HWE
+  arma::vec genicAA(nPairs,arma::fill::zeros); // No LD
+  arma::vec genicAA2(nPairs,arma::fill::zeros); // No LD and HWE
+  arma::vec mu(nPairs,arma::fill::zeros); // Observed mean
+  arma::vec eMu(nPairs,arma::fill::zeros); // Expected mean with HWE
   if(hasD){
     d = Rcpp::as<arma::vec>(trait.slot("domEff"));
-    ddMat.set_size(nInd,nThreads);
-    ddMat.zeros();
-    gv_d.set_size(nInd,nThreads);
-    gv_d.zeros();
+    ddTab.set_size(epi.nGeno,nPairs);
+    dTab.set_size(epi.nGeno,nPairs);
   }
   arma::vec x(ploidy+1); // Genotype dosage
   for(arma::uword i=0; i<x.n_elem; ++i)
     x(i) = double(i);
   arma::vec xa = (x-dP/2.0)*(2.0/dP);
   arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
-  arma::Mat<unsigned char> genoMat = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(pop.slot("geno")), 
+  arma::Mat<unsigned char> genoMat = getGeno(GenoView(SEXP(pop.slot("geno"))), 
                                              lociPerChr, lociLoc, nThreads);
+  arma::umat pairCount = epi.countGeno(genoMat, nThreads);
   
+  // First pass over pairs of loci computes their statistics
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static) num_threads(nThreads)
 #endif
-  for(arma::uword i=0; i<E.n_rows; ++i){
+  for(arma::uword i=0; i<nPairs; ++i){
     double gvMu1, gvMu2, gvEMu1, gvEMu2, 
     genoMu1, genoMu2, p1, p2, q1, q2, dK, 
     alpha1, alpha2, alphaE1, alphaE2, 
     gvMu, gvEMu, gvNoLDMu;
-    
-    arma::uword tid; //Thread ID
-#ifdef _OPENMP
-    tid = omp_get_thread_num();
-#else
-    tid = 0;
-#endif
+    arma::uword l1 = epi.loci(0,i);
+    arma::uword l2 = epi.loci(1,i);
+    double e = epi.eff(i);
     
     //Observed frequencies
-    arma::mat freq(ploidy+1,ploidy+1,arma::fill::zeros);
-    for(arma::uword j=0; j<nInd; ++j){
-      freq(genoMat(j,E(i,0)),genoMat(j,E(i,1))) += 1;
-    }
+    arma::mat freq = arma::conv_to<arma::mat>::from(pairCount.col(i));
+    freq.reshape(ploidy+1,ploidy+1);
     freq = freq/accu(freq);
     arma::vec freq1 = sum(freq,1);
     arma::vec freq2 = sum(freq,0).t();
@@ -101,26 +99,26 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
     
     //Marginal values (individual loci)
     //Additive effects
-    arma::vec aEff1 = xa*a(E(i,0));
-    arma::vec aEff2 = xa*a(E(i,1));
+    arma::vec aEff1 = xa*a(l1);
+    arma::vec aEff2 = xa*a(l2);
     //Additive-by-additive effects
-    arma::mat aaEff = xa*xa.t()*E(i,2);
+    arma::mat aaEff = xa*xa.t()*e;
     //Dominance effects
     arma::vec dEff1, dEff2;
     //Genetic value
     arma::vec gv1, gv2, gvE1, gvE2;
     if(hasD){
-      dEff1 = xd*d(E(i,0));
-      dEff2 = xd*d(E(i,1));
+      dEff1 = xd*d(l1);
+      dEff2 = xd*d(l2);
       gv1 = aEff1+dEff1;
       gv2 = aEff2+dEff2;
       gvE1 = gv1;
       gvE2 = gv2;
       for(arma::uword j=0; j<(ploidy+1); ++j){
-        gv1(j) += accu(freq2%(aEff2+dEff2+E(i,2)*xa(j)*xa));
-        gv2(j) += accu(freq1%(aEff1+dEff1+E(i,2)*xa(j)*xa));
-        gvE1(j) += accu(freqE2%(aEff2+dEff2+E(i,2)*xa(j)*xa));
-        gvE2(j) += accu(freqE1%(aEff1+dEff1+E(i,2)*xa(j)*xa));
+        gv1(j) += accu(freq2%(aEff2+dEff2+e*xa(j)*xa));
+        gv2(j) += accu(freq1%(aEff1+dEff1+e*xa(j)*xa));
+        gvE1(j) += accu(freqE2%(aEff2+dEff2+e*xa(j)*xa));
+        gvE2(j) += accu(freqE1%(aEff1+dEff1+e*xa(j)*xa));
       }
     }else{
       gv1 = aEff1;
@@ -128,10 +126,10 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
       gvE1 = gv1;
       gvE2 = gv2;
       for(arma::uword j=0; j<(ploidy+1); ++j){
-        gv1(j) += accu(freq2%(aEff2+E(i,2)*xa(j)*xa));
-        gv2(j) += accu(freq1%(aEff1+E(i,2)*xa(j)*xa));
-        gvE1(j) += accu(freqE2%(aEff2+E(i,2)*xa(j)*xa));
-        gvE2(j) += accu(freqE1%(aEff1+E(i,2)*xa(j)*xa));
+        gv1(j) += accu(freq2%(aEff2+e*xa(j)*xa));
+        gv2(j) += accu(freq1%(aEff1+e*xa(j)*xa));
+        gvE1(j) += accu(freqE2%(aEff2+e*xa(j)*xa));
+        gvE2(j) += accu(freqE1%(aEff1+e*xa(j)*xa));
       }
     }
     
@@ -161,10 +159,10 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
     bvE1 = (x-genoMu1)*alphaE1; //Random mating breeding value
     bv2 = (x-genoMu2)*alpha2; //Breeding values
     bvE2 = (x-genoMu2)*alphaE2; //Random mating breeding value
-    genicA(tid) += accu(freq1%bv1%bv1);
-    genicA2(tid) += accu(freqE1%bvE1%bvE1);
-    genicA(tid) += accu(freq2%bv2%bv2);
-    genicA2(tid) += accu(freqE2%bvE2%bvE2);
+    genicA(i) += accu(freq1%bv1%bv1);
+    genicA2(i) += accu(freqE1%bvE1%bvE1);
+    genicA(i) += accu(freq2%bv2%bv2);
+    genicA2(i) += accu(freqE2%bvE2%bvE2);
     //Dominance deviation
     arma::vec dd1, dd2, ddE1, ddE2;
     if(hasD){
@@ -172,10 +170,10 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
       ddE1 = gvE1-bvE1-gvEMu1; //Random mating dominance deviation
       dd2 = gv2-bv2-gvMu2; //Dominance deviations (lack of fit)
       ddE2 = gvE2-bvE2-gvEMu2; //Random mating dominance deviation
-      genicD(tid) += accu(freq1%dd1%dd1);
-      genicD2(tid) += accu(freqE1%ddE1%ddE1);
-      genicD(tid) += accu(freq2%dd2%dd2);
-      genicD2(tid) += accu(freqE2%ddE2%ddE2);
+      genicD(i) += accu(freq1%dd1%dd1);
+      genicD2(i) += accu(freqE1%ddE1%ddE1);
+      genicD(i) += accu(freq2%dd2%dd2);
+      genicD2(i) += accu(freqE2%ddE2%ddE2);
     }
     
     //Joint values (both loci)
@@ -196,22 +194,22 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
         BV(j,k) = bv1(j)+bv2(k);
         BVE(j,k) = bvE1(j)+bvE2(k);
         if(hasD){
-          GV(j,k) = xa(j)*a(E(i,0)) + xa(k)*a(E(i,1)) +
-            xd(j)*d(E(i,0)) + xd(k)*d(E(i,1)) + 
-            xa(j)*xa(k)*E(i,2);
+          GV(j,k) = xa(j)*a(l1) + xa(k)*a(l2) +
+            xd(j)*d(l1) + xd(k)*d(l2) + 
+            xa(j)*xa(k)*e;
           DD(j,k) = dd1(j)+dd2(k);
           DDE(j,k) = ddE1(j)+ddE2(k);
         }else{
-          GV(j,k) = xa(j)*a(E(i,0)) + xa(k)*a(E(i,1)) +
-            xa(j)*xa(k)*E(i,2);
+          GV(j,k) = xa(j)*a(l1) + xa(k)*a(l2) +
+            xa(j)*xa(k)*e;
         }
       }
     }
     gvMu = accu(freq%GV);
     gvNoLDMu = accu(freqNoLD%GV);
     gvEMu = accu(freqNoLDE%GV);
-    mu(tid) += gvMu;
-    eMu(tid) += gvEMu;
+    mu(i) += gvMu;
+    eMu(i) += gvEMu;
     if(hasD){
       AA = GV-BV-DD-gvMu;
       AANoLD = GV-BV-DD-gvNoLDMu;
@@ -221,29 +219,56 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
       AANoLD = GV-BV-gvNoLDMu;
       AAE = GV-BVE-gvEMu;
     }
-    genicAA(tid) += accu(freqNoLD%AANoLD%AANoLD);
-    genicAA2(tid) += accu(freqNoLDE%AAE%AAE);
+    genicAA(i) += accu(freqNoLD%AANoLD%AANoLD);
+    genicAA2(i) += accu(freqNoLDE%AAE%AAE);
     
-    //Fill in individual effects
-    for(arma::uword j=0; j<nInd; ++j){
-      bvMat(j,tid) += BV(genoMat(j,E(i,0)),genoMat(j,E(i,1)));
-      aaMat(j,tid) += AA(genoMat(j,E(i,0)),genoMat(j,E(i,1)));
-      gv_a(j,tid) += aEff1(genoMat(j,E(i,0)))+aEff2(genoMat(j,E(i,1)));
-      gv_aa(j,tid) += aaEff(genoMat(j,E(i,0)),genoMat(j,E(i,1)));
-      if(hasD){
-        ddMat(j,tid) += DD(genoMat(j,E(i,0)),genoMat(j,E(i,1)));
-        gv_d(j,tid) += dEff1(genoMat(j,E(i,0)))+dEff2(genoMat(j,E(i,1)));
+    //Store values for individuals
+    bvTab.col(i) = arma::vectorise(BV);
+    aaTab.col(i) = arma::vectorise(AA);
+    aaEffTab.col(i) = arma::vectorise(aaEff);
+    for(arma::uword k=0; k<(ploidy+1); ++k){
+      for(arma::uword j=0; j<(ploidy+1); ++j){
+        aTab(j+k*(ploidy+1),i) = aEff1(j)+aEff2(k);
+        if(hasD){
+          dTab(j+k*(ploidy+1),i) = dEff1(j)+dEff2(k);
+        }
       }
     }
-    
+    if(hasD){
+      ddTab.col(i) = arma::vectorise(DD);
+    }
   }
   
+  // Second pass adds the tabled values for each individual
+  arma::vec bvVec(nInd,arma::fill::zeros), aaVec(nInd,arma::fill::zeros),
+  gv_a(nInd,arma::fill::zeros), gv_aa(nInd,arma::fill::zeros), ddVec, gv_d;
   if(hasD){
-    gv_t = gv_a + gv_d + gv_aa;
-    return Rcpp::List::create(Rcpp::Named("gv")=sum(gv_t,1)+intercept,
-                              Rcpp::Named("bv")=sum(bvMat,1),
-                              Rcpp::Named("dd")=sum(ddMat,1),
-                              Rcpp::Named("aa")=sum(aaMat,1),
+    ddVec.zeros(nInd);
+    gv_d.zeros(nInd);
+  }
+  std::vector<const arma::mat*> tables;
+  std::vector<arma::vec*> values;
+  tables.push_back(&bvTab);
+  values.push_back(&bvVec);
+  tables.push_back(&aaTab);
+  values.push_back(&aaVec);
+  tables.push_back(&aTab);
+  values.push_back(&gv_a);
+  tables.push_back(&aaEffTab);
+  values.push_back(&gv_aa);
+  if(hasD){
+    tables.push_back(&ddTab);
+    values.push_back(&ddVec);
+    tables.push_back(&dTab);
+    values.push_back(&gv_d);
+  }
+  epi.addValues(genoMat, tables, values, nThreads);
+  
+  if(hasD){
+    return Rcpp::List::create(Rcpp::Named("gv")=gv_a+gv_d+gv_aa+intercept,
+                              Rcpp::Named("bv")=bvVec,
+                              Rcpp::Named("dd")=ddVec,
+                              Rcpp::Named("aa")=aaVec,
                               Rcpp::Named("genicVarA")=accu(genicA),
                               Rcpp::Named("genicVarD")=accu(genicD),
                               Rcpp::Named("genicVarAA")=accu(genicAA),
@@ -252,27 +277,85 @@ Rcpp::List calcGenParamE(const Rcpp::S4& trait,
                               Rcpp::Named("genicVarAA2")=accu(genicAA2),
                               Rcpp::Named("mu")=accu(mu)+intercept,
                               Rcpp::Named("mu_HWE")=accu(eMu)+intercept,
-                              Rcpp::Named("gv_a")=sum(gv_a,1),
-                              Rcpp::Named("gv_d")=sum(gv_d,1),
-                              Rcpp::Named("gv_aa")=sum(gv_aa,1),
+                              Rcpp::Named("gv_a")=gv_a,
+                              Rcpp::Named("gv_d")=gv_d,
+                              Rcpp::Named("gv_aa")=gv_aa,
                               Rcpp::Named("gv_mu")=intercept);
   }else{
-    gv_t = gv_a + gv_aa;
-    return Rcpp::List::create(Rcpp::Named("gv")=sum(gv_t,1)+intercept,
-                              Rcpp::Named("bv")=sum(bvMat,1),
-                              Rcpp::Named("aa")=sum(aaMat,1),
+    return Rcpp::List::create(Rcpp::Named("gv")=gv_a+gv_aa+intercept,
+                              Rcpp::Named("bv")=bvVec,
+                              Rcpp::Named("aa")=aaVec,
                               Rcpp::Named("genicVarA")=accu(genicA),
                               Rcpp::Named("genicVarAA")=accu(genicAA),
                               Rcpp::Named("genicVarA2")=accu(genicA2),
                               Rcpp::Named("genicVarAA2")=accu(genicAA2),
                               Rcpp::Named("mu")=accu(mu)+intercept,
                               Rcpp::Named("mu_HWE")=accu(eMu)+intercept,
-                              Rcpp::Named("gv_a")=sum(gv_a,1),
-                              Rcpp::Named("gv_aa")=sum(gv_aa,1),
+                              Rcpp::Named("gv_a")=gv_a,
+                              Rcpp::Named("gv_aa")=gv_aa,
                               Rcpp::Named("gv_mu")=intercept);
   }
 }
 
+// Genic parameters of a single locus
+struct LocusParam{
+  double mu, eMu; // Observed mean and expected mean with HWE
+  double genicA, genicA2; // Additive, no LD and no LD with HWE
+  double genicD, genicD2; // Dominance, no LD and no LD with HWE
+};
+
+// Calculates the genic parameters of a locus from its genotype 
+// frequencies and genetic values by dosage. Breeding values and 
+// dominance deviations by dosage are returned in bv and dd.
+LocusParam locusParam(const arma::vec& freq, const arma::vec& x,
+                      const arma::vec& gv, double dP, bool hasD,
+                      arma::vec& bv, arma::vec& dd){
+  LocusParam output;
+  arma::uword ploidy = x.n_elem-1;
+  double genoMu, p, q, dK, alpha, alphaE;
+  genoMu = accu(freq%x);
+  p = genoMu/dP;
+  q = 1-p;
+  
+  // Expected genotype frequencies
+  arma::vec freqE(ploidy+1);
+  for(arma::uword k=0; k<(ploidy+1); ++k){
+    dK = double(k);
+    freqE(k) = choose(dP,dK)*std::pow(p,dK)*std::pow(q,dP-dK);
+  }
+  
+  // Mean genetic values
+  output.mu = accu(freq%gv);
+  output.eMu = accu(freqE%gv);
+  
+  // Average effect
+  alpha = accu(freq%(gv-output.mu)%(x-genoMu))/
+    accu(freq%(x-genoMu)%(x-genoMu));
+  alphaE = accu(freqE%(gv-output.eMu)%(x-genoMu))/
+    accu(freqE%(x-genoMu)%(x-genoMu)); 
+  
+  // Check for divide by zero
+  if(!std::isfinite(alpha)) alpha=0;
+  if(!std::isfinite(alphaE)) alphaE=0;
+  
+  // Set additive genic variances
+  bv = (x-genoMu)*alpha; //Breeding values
+  arma::vec bvE = (x-genoMu)*alphaE; //Random mating breeding value
+  output.genicA = accu(freq%bv%bv);
+  output.genicA2 = accu(freqE%bvE%bvE);
+  
+  // Set dominance genic variances
+  output.genicD = 0;
+  output.genicD2 = 0;
+  if(hasD){
+    dd = gv-bv-output.mu; //Dominance deviations (lack of fit)
+    arma::vec ddE = gv-bvE-output.eMu; //Random mating dominance deviation
+    output.genicD = accu(freq%dd%dd);
+    output.genicD2 = accu(freqE%ddE%ddE);
+  }
+  return output;
+}
+
 // Calculates breeding values, dominance deviations and genic
 // variances. Additive and dominance genetic variances are calculated
 // from breeding values and dominance deviations. 
@@ -299,132 +382,222 @@ Rcpp::List calcGenParam(const Rcpp::S4& trait,
   arma::vec xa = (x-dP/2.0)*(2.0/dP);
   arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
   double intercept = trait.slot("intercept");
-  arma::mat bvMat(nInd,nThreads,arma::fill::zeros); // "Breeding value"
-  arma::mat gv_t; // Total genetic value
-  arma::mat gv_a(nInd,nThreads,arma::fill::zeros); // Genetic value due to a
-  arma::vec genicA(nThreads,arma::fill::zeros); // No LD
-  arma::vec genicA2(nThreads,arma::fill::zeros); // No LD and HWE
-  arma::vec genicD(nThreads,arma::fill::zeros); // No LD
-  arma::vec genicD2(nThreads,arma::fill::zeros); // No LD and HWE
-  arma::vec mu(nThreads,arma::fill::zeros); // Observed mean
-  arma::vec eMu(nThreads,arma::fill::zeros); // Expected mean with HWE
-  arma::mat ddMat, gv_d; // Dominance deviation and genetic value due to d
+  arma::uword nLoci = a.n_elem;
+  // Contributions of each locus
+  arma::vec genicA(nLoci,arma::fill::zeros); // No LD
+  arma::vec genicA2(nLoci,arma::fill::zeros); // No LD and HWE
+  arma::vec genicD(nLoci,arma::fill::zeros); // No LD
+  arma::vec genicD2(nLoci,arma::fill::zeros); // No LD and HWE
+  arma::vec mu(nLoci,arma::fill::zeros); // Observed mean
+  arma::vec eMu(nLoci,arma::fill::zeros); // Expected mean with HWE
+  // Values for individuals
+  arma::vec bvVec(nInd,arma::fill::zeros); // "Breeding value"
+  arma::vec gv_a(nInd,arma::fill::zeros); // Genetic value due to a
+  arma::vec ddVec, gv_d; // Dominance deviation and genetic value due to d
   if(hasD){
     d = Rcpp::as<arma::vec>(trait.slot("domEff"));
-    ddMat.set_size(nInd,nThreads);
-    ddMat.zeros();
-    gv_d.set_size(nInd,nThreads);
-    gv_d.zeros();
+    ddVec.zeros(nInd);
+    gv_d.zeros(nInd);
   }
   
-  arma::Mat<unsigned char> genoMat = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(pop.slot("geno")), 
-                                             lociPerChr, lociLoc, nThreads);
+  // Chromosome of each locus, for decoding panels of loci
+  std::vector<arma::uword> locusChr;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    locusChr.insert(locusChr.end(), lociPerChr(chr), chr);
+  }
+  GenoView geno(SEXP(pop.slot("geno")));
+  arma::uword nBlocks = (nInd+indBlock-1)/indBlock;
   
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) num_threads(nThreads)
-#endif
-  for(arma::uword i=0; i<a.n_elem; ++i){
-    
-    arma::uword tid; //Thread ID
-#ifdef _OPENMP
-    tid = omp_get_thread_num();
-#else
-    tid = 0;
-#endif
-    
-    arma::vec freq(ploidy+1,arma::fill::zeros), freqE(ploidy+1); // Genotype frequencies, observed and HWE
-    arma::vec aEff(ploidy+1), dEff(ploidy+1), eff(ploidy+1); // Genetic values, additive and dominance
-    arma::vec bv(ploidy+1), dd(ploidy+1), gv(ploidy+1); // Statistical values, additive and dominance
-    arma::vec bvE(ploidy+1), ddE(ploidy+1); //Expected for random mating
-    double gvMu, gvEMu, genoMu, p, q, dK, alpha, alphaE;
-    
-    // Compute genotype frequencies
-    for(arma::uword j=0; j<nInd; ++j){
-      freq(genoMat(j,i)) += 1;
+  for(arma::uword panel=0; panel<nLoci; panel+=lociPanel){
+    arma::uword nPanel = std::min(lociPanel,nLoci-panel);
+    arma::Col<int> panelPerChr(lociPerChr.n_elem,arma::fill::zeros);
+    for(arma::uword i=panel; i<(panel+nPanel); ++i){
+      panelPerChr(locusChr[i]) += 1;
     }
-    freq = freq/accu(freq);
-    genoMu = accu(freq%x);
-    p = genoMu/dP;
-    q = 1-p;
-    
-    // Expected genotype frequencies
-    freqE.zeros();
-    for(arma::uword k=0; k<(ploidy+1); ++k){
-      dK = double(k);
-      freqE(k) = choose(dP,dK)*std::pow(p,dK)*std::pow(q,dP-dK);
-    }
-    
-    // Set genetic values
-    aEff = xa*a(i);
+    arma::Mat<unsigned char> genoMat = getGeno(geno, panelPerChr, 
+                                               lociLoc.subvec(panel,panel+nPanel-1), 
+                                               nThreads);
+    // Values by dosage for each locus in the panel
+    arma::mat aTab(ploidy+1,nPanel), bvTab(ploidy+1,nPanel), dTab, ddTab;
     if(hasD){
-      dEff = xd*d(i);
-      gv = aEff+dEff;
-    }else{
-      gv = aEff;
+      dTab.set_size(ploidy+1,nPanel);
+      ddTab.set_size(ploidy+1,nPanel);
     }
     
-    // Mean genetic values
-    gvMu = accu(freq%gv);
-    gvEMu =  accu(freqE%gv);
-    mu(tid) += gvMu;
-    eMu(tid) += gvEMu;
-    
-    // Average effect
-    alpha = accu(freq%(gv-gvMu)%(x-genoMu))/
-      accu(freq%(x-genoMu)%(x-genoMu));
-    alphaE = accu(freqE%(gv-gvEMu)%(x-genoMu))/
-      accu(freqE%(x-genoMu)%(x-genoMu)); 
-    
-    // Check for divide by zero
-    if(!std::isfinite(alpha)) alpha=0;
-    if(!std::isfinite(alphaE)) alphaE=0;
-    
-    // Set additive genic variances
-    bv = (x-genoMu)*alpha; //Breeding values
-    bvE = (x-genoMu)*alphaE; //Random mating breeding value
-    genicA(tid) += accu(freq%bv%bv);
-    genicA2(tid) += accu(freqE%bvE%bvE);
-    
-    // Set dominance genic variances
-    if(hasD){
-      dd = gv-bv-gvMu; //Dominance deviations (lack of fit)
-      ddE = gv-bvE-gvEMu; //Random mating dominance deviation
-      genicD(tid) += accu(freq%dd%dd);
-      genicD2(tid) += accu(freqE%ddE%ddE);
+    // First pass over loci computes their statistics
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for(arma::uword m=0; m<nPanel; ++m){
+      arma::uword i = panel+m;
+      
+      arma::vec freq(ploidy+1,arma::fill::zeros); // Genotype frequencies
+      arma::vec aEff(ploidy+1), dEff(ploidy+1), gv(ploidy+1); // Genetic values
+      arma::vec bv(ploidy+1), dd(ploidy+1); // Statistical values, additive and dominance
+      
+      // Compute genotype frequencies
+      const unsigned char* dosage = genoMat.colptr(m);
+      for(arma::uword j=0; j<nInd; ++j){
+        freq(dosage[j]) += 1;
+      }
+      freq = freq/accu(freq);
+      
+      // Set genetic values
+      aEff = xa*a(i);
+      if(hasD){
+        dEff = xd*d(i);
+        gv = aEff+dEff;
+      }else{
+        gv = aEff;
+      }
+      
+      LocusParam par = locusParam(freq, x, gv, dP, hasD, bv, dd);
+      mu(i) = par.mu;
+      eMu(i) = par.eMu;
+      genicA(i) = par.genicA;
+      genicA2(i) = par.genicA2;
+      if(hasD){
+        genicD(i) = par.genicD;
+        genicD2(i) = par.genicD2;
+        dTab.col(m) = dEff;
+        ddTab.col(m) = dd;
+      }
+      aTab.col(m) = aEff;
+      bvTab.col(m) = bv;
     }
     
-    // Set values for individuals
-    for(arma::uword j=0; j<nInd; ++j){
-      gv_a(j,tid) += aEff(genoMat(j,i));
-      bvMat(j,tid) += bv(genoMat(j,i));
-      if(hasD){
-        gv_d(j,tid) += dEff(genoMat(j,i));
-        ddMat(j,tid) += dd(genoMat(j,i));
+    // Second pass accumulates values for blocks of individuals, so
+    // each individual is only updated by one thread
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for(arma::uword b=0; b<nBlocks; ++b){
+      arma::uword start = b*indBlock;
+      arma::uword stop = std::min(start+indBlock,nInd);
+      for(arma::uword k=0; k<nPanel; ++k){
+        const unsigned char* dosage = genoMat.colptr(k);
+        for(arma::uword j=start; j<stop; ++j){
+          gv_a(j) += aTab(dosage[j],k);
+          bvVec(j) += bvTab(dosage[j],k);
+          if(hasD){
+            gv_d(j) += dTab(dosage[j],k);
+            ddVec(j) += ddTab(dosage[j],k);
+          }
+        }
       }
     }
   }
+  
   if(hasD){
-    gv_t = gv_a + gv_d;
-    return Rcpp::List::create(Rcpp::Named("gv")=sum(gv_t,1)+intercept,
-                              Rcpp::Named("bv")=sum(bvMat,1),
-                              Rcpp::Named("dd")=sum(ddMat,1),
+    return Rcpp::List::create(Rcpp::Named("gv")=gv_a+gv_d+intercept,
+                              Rcpp::Named("bv")=bvVec,
+                              Rcpp::Named("dd")=ddVec,
                               Rcpp::Named("genicVarA")=accu(genicA),
                               Rcpp::Named("genicVarD")=accu(genicD),
                               Rcpp::Named("genicVarA2")=accu(genicA2),
                               Rcpp::Named("genicVarD2")=accu(genicD2),
                               Rcpp::Named("mu")=accu(mu)+intercept,
                               Rcpp::Named("mu_HWE")=accu(eMu)+intercept,
-                              Rcpp::Named("gv_a")=sum(gv_a,1),
-                              Rcpp::Named("gv_d")=sum(gv_d,1),
+                              Rcpp::Named("gv_a")=gv_a,
+                              Rcpp::Named("gv_d")=gv_d,
                               Rcpp::Named("gv_mu")=intercept);
   }else{
-    return Rcpp::List::create(Rcpp::Named("gv")=sum(gv_a,1)+intercept,
-                              Rcpp::Named("bv")=sum(bvMat,1),
+    return Rcpp::List::create(Rcpp::Named("gv")=gv_a+intercept,
+                              Rcpp::Named("bv")=bvVec,
                               Rcpp::Named("genicVarA")=accu(genicA),
                               Rcpp::Named("genicVarA2")=accu(genicA2),
                               Rcpp::Named("mu")=accu(mu)+intercept,
                               Rcpp::Named("mu_HWE")=accu(eMu)+intercept,
-                              Rcpp::Named("gv_a")=sum(gv_a,1),
+                              Rcpp::Named("gv_a")=gv_a,
                               Rcpp::Named("gv_mu")=intercept);
   }
 }
+
+// Counts the individuals with each dosage at a set of loci directly 
+// from the packed genotypes, without decoding a genotype matrix
+arma::umat countGeno(const GenoView& geno, 
+                     const arma::Col<int>& lociPerChr,
+                     arma::uvec lociLoc, int nThreads){
+  arma::uvec column;
+  std::vector<std::vector<arma::uword> > bins = lociBins(lociPerChr, lociLoc,
+                                                         column);
+  arma::field<arma::umat> counts = countBins(geno, bins, true, nThreads);
+  arma::umat output(geno.ploidy+1,lociLoc.n_elem);
+  arma::uword i = 0;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    for(int j=0; j<lociPerChr(chr); ++j, ++i){
+      output.col(i) = counts(chr).col(column(i));
+    }
+  }
+  return output;
+}
+
+// Counts the individuals with each dosage at the loci of a LociMap
+// [[Rcpp::export]]
+arma::umat calcGenoCount(const Rcpp::S4& lociMap, 
+                         const Rcpp::S4& pop,
+                         int nThreads){
+  const arma::Col<int>& lociPerChr = lociMap.slot("lociPerChr");
+  arma::uvec lociLoc = lociMap.slot("lociLoc");
+  return countGeno(GenoView(SEXP(pop.slot("geno"))), lociPerChr, lociLoc, nThreads);
+}
+
+// Calculates genic variances and means from genotype counts only.
+// Traits with epistasis aren't supported, use calcGenParam.
+// [[Rcpp::export]]
+Rcpp::List calcGenicParam(const Rcpp::S4& trait, 
+                          const Rcpp::S4& pop,
+                          int nThreads){
+  if(trait.hasSlot("epiEff")){
+    Rcpp::stop("Traits with epistasis require calcGenParam");
+  }
+  bool hasD = trait.hasSlot("domEff");
+  arma::uword ploidy = pop.slot("ploidy");
+  double dP = double(ploidy);
+  const arma::Col<int>& lociPerChr = trait.slot("lociPerChr");
+  arma::uvec lociLoc = trait.slot("lociLoc");
+  arma::vec a = trait.slot("addEff");
+  arma::vec d;
+  if(hasD){
+    d = Rcpp::as<arma::vec>(trait.slot("domEff"));
+  }
+  arma::vec x(ploidy+1); // Genotype dosage
+  for(arma::uword i=0; i<x.n_elem; ++i)
+    x(i) = double(i);
+  arma::vec xa = (x-dP/2.0)*(2.0/dP);
+  arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
+  double intercept = trait.slot("intercept");
+  arma::uword nLoci = a.n_elem;
+  
+  arma::umat genoCount = countGeno(GenoView(SEXP(pop.slot("geno"))), 
+                                   lociPerChr, lociLoc, nThreads);
+  arma::vec genicA(nLoci), genicA2(nLoci), genicD(nLoci), genicD2(nLoci),
+  mu(nLoci), eMu(nLoci);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword i=0; i<nLoci; ++i){
+    arma::vec freq = arma::conv_to<arma::vec>::from(genoCount.col(i));
+    freq = freq/accu(freq);
+    arma::vec gv = xa*a(i);
+    if(hasD){
+      gv += xd*d(i);
+    }
+    arma::vec bv, dd;
+    LocusParam par = locusParam(freq, x, gv, dP, hasD, bv, dd);
+    mu(i) = par.mu;
+    eMu(i) = par.eMu;
+    genicA(i) = par.genicA;
+    genicA2(i) = par.genicA2;
+    genicD(i) = par.genicD;
+    genicD2(i) = par.genicD2;
+  }
+  
+  return Rcpp::List::create(Rcpp::Named("genoCount")=genoCount,
+                            Rcpp::Named("genicVarA")=accu(genicA),
+                            Rcpp::Named("genicVarD")=accu(genicD),
+                            Rcpp::Named("genicVarA2")=accu(genicA2),
+                            Rcpp::Named("genicVarD2")=accu(genicD2),
+                            Rcpp::Named("mu")=accu(mu)+intercept,
+                            Rcpp::Named("mu_HWE")=accu(eMu)+intercept);
+}
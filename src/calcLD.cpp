@@ -0,0 +1,163 @@
+#include "alphasimr.h"
+
+// Loci per tile when calculating LD between two sets of loci
+const arma::uword ldTile = 64;
+
+// Alleles of loci on a chromosome as bit vectors over all haplotypes,
+// nWords 64-bit words per locus. Haplotypes are read 8 at a time and
+// the bins holding the loci are transposed, so bit h of a locus's
+// vector is the locus's allele in haplotype h.
+std::vector<uint64_t> lociBits(const GenoView& geno, arma::uword chr,
+                               const arma::uvec& loci, arma::uword nWords,
+                               int nThreads){
+  arma::uword nHap = geno.ploidy*geno.nInd;
+  arma::uword nLoci = loci.n_elem;
+  std::vector<uint64_t> output(nLoci*nWords, 0);
+  unsigned char* bytes = reinterpret_cast<unsigned char*>(output.data());
+  arma::uword nGroups = (nHap+7)/8;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword g=0; g<nGroups; ++g){
+    arma::uword nH = std::min<arma::uword>(8, nHap-8*g);
+    std::vector<const unsigned char*> haplo(nH);
+    for(arma::uword h=0; h<nH; ++h){
+      arma::uword hap = 8*g+h;
+      haplo[h] = geno.haplo(chr, hap%geno.ploidy, hap/geno.ploidy);
+    }
+    arma::uword lastBin = geno.nBins[chr];
+    uint64_t x = 0;
+    for(arma::uword i=0; i<nLoci; ++i){
+      arma::uword bin = loci(i)/8;
+      if(bin!=lastBin){
+        x = 0;
+        for(arma::uword h=0; h<nH; ++h){
+          x |= static_cast<uint64_t>(haplo[h][bin]) << (8*h);
+        }
+        x = transposeBits(x);
+        lastBin = bin;
+      }
+      // Bytes within a word are filled in order of significance
+      arma::uword byte = g%8;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      byte = 7-byte;
+#endif
+      bytes[8*(i*nWords+g/8)+byte] =
+        static_cast<unsigned char>(x >> (8*(loci(i)%8)));
+    }
+  }
+  return output;
+}
+
+// r^2 and D' from the number of haplotypes with the 1 allele at each
+// locus and at both loci. D' is reported as an absolute value. Both
+// are NA if either locus is monomorphic.
+inline void ldStats(double n1, double n2, double n12, double nHap,
+                    double& r2, double& dPrime){
+  double p1 = n1/nHap;
+  double p2 = n2/nHap;
+  double D = n12/nHap - p1*p2;
+  double denom = p1*(1-p1)*p2*(1-p2);
+  if(denom<=0){
+    r2 = NA_REAL;
+    dPrime = NA_REAL;
+    return;
+  }
+  r2 = D*D/denom;
+  double Dmax;
+  if(D<0){
+    Dmax = std::min(p1*p2, (1-p1)*(1-p2));
+  }else{
+    Dmax = std::min(p1*(1-p2), (1-p1)*p2);
+  }
+  dPrime = std::abs(D)/Dmax;
+}
+
+// Count of haplotypes with the 1 allele at both loci
+inline double countBoth(const uint64_t* x, const uint64_t* y,
+                        arma::uword nWords){
+  uint64_t n = 0;
+  for(arma::uword w=0; w<nWords; ++w){
+    n += __builtin_popcountll(x[w] & y[w]);
+  }
+  return double(n);
+}
+
+// Calculates LD between each locus and the next window loci, giving
+// banded matrices with a row for each locus and a column for each
+// distance in loci
+// [[Rcpp::export]]
+Rcpp::List calcLdWindow(SEXP geno, arma::uword chr, arma::uvec loci,
+                        arma::uword window, int nThreads){
+  GenoView view(geno);
+  chr -= 1; // R to C++
+  loci -= 1; // R to C++
+  arma::uword nLoci = loci.n_elem;
+  double nHap = double(view.ploidy*view.nInd);
+  arma::uword nWords = (view.ploidy*view.nInd+63)/64;
+  std::vector<uint64_t> bits = lociBits(view, chr, loci, nWords, nThreads);
+  arma::vec n1(nLoci);
+  for(arma::uword i=0; i<nLoci; ++i){
+    n1(i) = countBoth(&bits[i*nWords], &bits[i*nWords], nWords);
+  }
+  arma::mat r2(nLoci, window), dPrime(nLoci, window);
+  r2.fill(NA_REAL);
+  dPrime.fill(NA_REAL);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword i=0; i<nLoci; ++i){
+    arma::uword nPair = std::min(window, nLoci-i-1);
+    for(arma::uword k=0; k<nPair; ++k){
+      arma::uword j = i+k+1;
+      double n12 = countBoth(&bits[i*nWords], &bits[j*nWords], nWords);
+      ldStats(n1(i), n1(j), n12, nHap, r2(i,k), dPrime(i,k));
+    }
+  }
+  return Rcpp::List::create(Rcpp::Named("r2")=r2,
+                            Rcpp::Named("Dprime")=dPrime);
+}
+
+// Calculates LD between all pairs of loci from two sets on a
+// chromosome, in tiles of 64 by 64 loci
+// [[Rcpp::export]]
+Rcpp::List calcLdPair(SEXP geno, arma::uword chr, arma::uvec loci1,
+                      arma::uvec loci2, int nThreads){
+  GenoView view(geno);
+  chr -= 1; // R to C++
+  loci1 -= 1; // R to C++
+  loci2 -= 1; // R to C++
+  arma::uword nLoci1 = loci1.n_elem;
+  arma::uword nLoci2 = loci2.n_elem;
+  double nHap = double(view.ploidy*view.nInd);
+  arma::uword nWords = (view.ploidy*view.nInd+63)/64;
+  std::vector<uint64_t> bits1 = lociBits(view, chr, loci1, nWords, nThreads);
+  std::vector<uint64_t> bits2 = lociBits(view, chr, loci2, nWords, nThreads);
+  arma::vec n1(nLoci1), n2(nLoci2);
+  for(arma::uword i=0; i<nLoci1; ++i){
+    n1(i) = countBoth(&bits1[i*nWords], &bits1[i*nWords], nWords);
+  }
+  for(arma::uword j=0; j<nLoci2; ++j){
+    n2(j) = countBoth(&bits2[j*nWords], &bits2[j*nWords], nWords);
+  }
+  arma::mat r2(nLoci1, nLoci2), dPrime(nLoci1, nLoci2);
+  arma::uword nTiles1 = (nLoci1+ldTile-1)/ldTile;
+  arma::uword nTiles2 = (nLoci2+ldTile-1)/ldTile;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+#endif
+  for(arma::uword t=0; t<(nTiles1*nTiles2); ++t){
+    arma::uword start1 = (t%nTiles1)*ldTile;
+    arma::uword stop1 = std::min(start1+ldTile, nLoci1);
+    arma::uword start2 = (t/nTiles1)*ldTile;
+    arma::uword stop2 = std::min(start2+ldTile, nLoci2);
+    for(arma::uword j=start2; j<stop2; ++j){
+      for(arma::uword i=start1; i<stop1; ++i){
+        double n12 = countBoth(&bits1[i*nWords], &bits2[j*nWords], nWords);
+        ldStats(n1(i), n2(j), n12, nHap, r2(i,j), dPrime(i,j));
+      }
+    }
+  }
+  return Rcpp::List::create(Rcpp::Named("r2")=r2,
+                            Rcpp::Named("Dprime")=dPrime);
+}
@@ -178,6 +178,7 @@ Node::Node(NodeType iType,short int iPopulation,double dHeight):
   this->topEdgeSize=0;
   this->bottomEdgeSize=0;
   this->bDeleted = false;
+  this->iTreeSeqId = -1;
 }
 
 Node::~Node(){
@@ -201,6 +202,10 @@ Event::Event(EventType iType,double dTime):
   if (dTime>Node::MAX_HEIGHT) throw "Stop here\n";
 }
 
+Event * Event::clone(){
+  return new Event(iType,dTime);
+}
+
 
 
 GenericEvent::GenericEvent(EventType iType,double dTime,
@@ -214,6 +219,10 @@ double GenericEvent::getParamValue(){
   return this->dParameterValue;
 }
 
+Event * GenericEvent::clone(){
+  return new GenericEvent(getType(),getTime(),dParameterValue);
+}
+
 MigrationEvent::MigrationEvent(EventType iType,double dTime,
                                short int iPopMigratedTo,short int iPopMigratedFrom):
   Event(iType,dTime){
@@ -221,6 +230,11 @@ MigrationEvent::MigrationEvent(EventType iType,double dTime,
   this->iPopMigratedFrom = iPopMigratedFrom;
 }
 
+Event * MigrationEvent::clone(){
+  return new MigrationEvent(getType(),getTime(),iPopMigratedTo,
+                            iPopMigratedFrom);
+}
+
 MigrationRateEvent::MigrationRateEvent(EventType iType,
                                        double dTime,short int iSourcePop,short int iDestPop,
                                        double dRate):
@@ -242,6 +256,11 @@ double MigrationRateEvent::getRate(){
   return this->dRate;
 }
 
+Event * MigrationRateEvent::clone(){
+  return new MigrationRateEvent(getType(),getTime(),iSourcePop,iDestPop,
+                                dRate);
+}
+
 MigrationRateMatrixEvent::MigrationRateMatrixEvent(
   EventType iType,double dTime,MatrixDouble dMigrationMatrix):
   Event(iType,dTime){
@@ -252,18 +271,30 @@ MatrixDouble MigrationRateMatrixEvent::getMigrationMatrix(){
   return this->dMigrationMatrix;
 }
 
+Event * MigrationRateMatrixEvent::clone(){
+  return new MigrationRateMatrixEvent(getType(),getTime(),dMigrationMatrix);
+}
+
 CoalEvent::CoalEvent(EventType iType,double dTime,
                      short int iPopulation):
   Event(iType,dTime){
   this->iPopulation = iPopulation;
 }
 
+Event * CoalEvent::clone(){
+  return new CoalEvent(getType(),getTime(),iPopulation);
+}
+
 
 XoverEvent::XoverEvent(EventType iType,double dTime,
                        short int iPopulation):Event(iType,dTime){
   this->iPopulation = iPopulation;
 }
 
+Event * XoverEvent::clone(){
+  return new XoverEvent(getType(),getTime(),iPopulation);
+}
+
 PopSizeChangeEvent::PopSizeChangeEvent(EventType iType,double dTime,
                                        short int iPopulationIndex,double dPopChangeParam):
   Event(iType,dTime){
@@ -280,6 +311,11 @@ double PopSizeChangeEvent::getPopChangeParam(){
   return dPopChangeParam;
 }
 
+Event * PopSizeChangeEvent::clone(){
+  return new PopSizeChangeEvent(getType(),getTime(),iPopulationIndex,
+                                dPopChangeParam);
+}
+
 
 PopJoinEvent::PopJoinEvent(EventType iType,double dTime,
                            short int iSourcePop,short int iDestPop):
@@ -296,9 +332,14 @@ short int PopJoinEvent::getDestPop(){
   return iDestPop;
 }
 
+Event * PopJoinEvent::clone(){
+  return new PopJoinEvent(getType(),getTime(),iSourcePop,iDestPop);
+}
+
 GraphBuilder::~GraphBuilder(){
   this->pConfig = NULL;
   this->pRandNumGenerator = NULL;
+  this->pTreeSeq = NULL;
   
   delete this->pEdgeListInARG;
   delete this->pEdgeVectorByPop;
@@ -318,7 +359,9 @@ GraphBuilder::~GraphBuilder(){
   delete pChrPositionQueue;
 }
 
-GraphBuilder::GraphBuilder(Configuration *pConfig,RandNumGenerator * pRG){
+GraphBuilder::GraphBuilder(Configuration *pConfig,RandNumGenerator * pRG,
+                           TreeSequence * pTreeSeq){
+  this->pTreeSeq = pTreeSeq;
   this->iGraphIteration = 0;
   this->bIncrementHistory = false;
   this->iTotalTreeEdges = 0;
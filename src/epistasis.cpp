@@ -0,0 +1,107 @@
+#include "alphasimr.h"
+#include <algorithm>
+
+// Individuals per block when adding values, so the genotypes of an
+// interaction's loci for a block stay in cache
+const arma::uword indBlock = 256;
+
+// Orders interactions by their loci
+struct LociOrder{
+  const arma::Mat<arma::uword>& loci;
+  explicit LociOrder(const arma::Mat<arma::uword>& loci_) : loci(loci_) {}
+  bool operator()(arma::uword i, arma::uword j) const{
+    for(arma::uword k=0; k<loci.n_rows; ++k){
+      if(loci(k,i)!=loci(k,j)){
+        return loci(k,i)<loci(k,j);
+      }
+    }
+    return i<j;
+  }
+};
+
+EpiLoci::EpiLoci(const arma::mat& E, arma::uword order,
+                 arma::uword ploidy) :
+  nInt(E.n_rows), order(order), ploidy(ploidy){
+  if(E.n_cols<(order+1)){
+    Rcpp::stop("Epistatic effects require a column for each locus and an effect column");
+  }
+  nGeno = 1;
+  for(arma::uword k=0; k<order; ++k){
+    nGeno *= ploidy+1;
+  }
+  arma::Mat<arma::uword> tmpLoci(order,nInt);
+  for(arma::uword i=0; i<nInt; ++i){
+    for(arma::uword k=0; k<order; ++k){
+      tmpLoci(k,i) = arma::uword(E(i,k))-1; // R to C++
+    }
+  }
+  std::vector<arma::uword> sortOrder(nInt);
+  for(arma::uword i=0; i<nInt; ++i){
+    sortOrder[i] = i;
+  }
+  std::sort(sortOrder.begin(), sortOrder.end(), LociOrder(tmpLoci));
+  loci.set_size(order,nInt);
+  eff.set_size(nInt);
+  for(arma::uword i=0; i<nInt; ++i){
+    loci.col(i) = tmpLoci.col(sortOrder[i]);
+    eff(i) = E(sortOrder[i],order);
+  }
+}
+
+arma::umat EpiLoci::countGeno(const arma::Mat<unsigned char>& genoMat,
+                              int nThreads) const{
+  arma::uword nInd = genoMat.n_rows;
+  arma::umat output(nGeno,nInt,arma::fill::zeros);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword i=0; i<nInt; ++i){
+    for(arma::uword j=0; j<nInd; ++j){
+      arma::uword row = 0;
+      for(arma::uword k=order; k>0; --k){
+        row = row*(ploidy+1) + genoMat(j,loci(k-1,i));
+      }
+      output(row,i) += 1;
+    }
+  }
+  return output;
+}
+
+// Works through blocks of individuals in parallel. Within a block,
+// the table rows of an interaction are found once and used for all
+// tables. Adding table values is a gather that compilers can
+// vectorize where the instruction set supports it.
+void EpiLoci::addValues(const arma::Mat<unsigned char>& genoMat,
+                        const std::vector<const arma::mat*>& tables,
+                        const std::vector<arma::vec*>& output,
+                        int nThreads) const{
+  arma::uword nInd = genoMat.n_rows;
+  arma::uword nTables = tables.size();
+  arma::uword nBlocks = (nInd+indBlock-1)/indBlock;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword b=0; b<nBlocks; ++b){
+    arma::uword start = b*indBlock;
+    arma::uword n = std::min(indBlock,nInd-start);
+    arma::uword row[indBlock];
+    for(arma::uword i=0; i<nInt; ++i){
+      for(arma::uword j=0; j<n; ++j){
+        row[j] = 0;
+      }
+      for(arma::uword k=order; k>0; --k){
+        const unsigned char* geno = genoMat.colptr(loci(k-1,i)) + start;
+        for(arma::uword j=0; j<n; ++j){
+          row[j] = row[j]*(ploidy+1) + geno[j];
+        }
+      }
+      for(arma::uword t=0; t<nTables; ++t){
+        const double* value = tables[t]->colptr(i);
+        double* out = output[t]->memptr() + start;
+        for(arma::uword j=0; j<n; ++j){
+          out[j] += value[row[j]];
+        }
+      }
+    }
+  }
+}
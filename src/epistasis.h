@@ -0,0 +1,31 @@
+#ifndef EPISTASIS_H
+#define EPISTASIS_H
+
+#include <vector>
+
+// Interactions between loci for epistasis
+// Each interaction involves order loci and its values are stored in
+// tables with one row for every combination of the loci's dosages.
+// The row for dosages g0, g1, ... is g0 + (ploidy+1)*g1 + ..., which
+// for pairs matches the memory layout of a (ploidy+1) x (ploidy+1)
+// matrix. Interactions are sorted by their loci, so consecutive
+// interactions share columns of the genotype matrix.
+class EpiLoci{
+public:
+  // Interactions from the epiEff slot of a trait, with 1-based loci
+  // in the first order columns and effects in the next column
+  EpiLoci(const arma::mat& E, arma::uword order, arma::uword ploidy);
+  // Number of individuals with each combination of dosages
+  arma::umat countGeno(const arma::Mat<unsigned char>& genoMat,
+                       int nThreads) const;
+  // Adds values from tables to output for all individuals
+  void addValues(const arma::Mat<unsigned char>& genoMat,
+                 const std::vector<const arma::mat*>& tables,
+                 const std::vector<arma::vec*>& output,
+                 int nThreads) const;
+  arma::uword nInt, order, ploidy, nGeno;
+  arma::Mat<arma::uword> loci; // order x nInt, 0-based
+  arma::vec eff; // Interaction effects
+};
+
+#endif
@@ -0,0 +1,665 @@
+// Alternative storage for the geno slot of populations
+// The genotypes of each chromosome are exposed to R as raw arrays
+// whose data is either a memory mapped region of a file or a list of
+// chunks from merged populations. Code reading the arrays, including
+// the C++ functions receiving pop@geno, is unaware of the storage.
+#include "alphasimr.h"
+#include <R_ext/Altrep.h>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static R_altrep_class_t mappedRawClass;
+static R_altrep_class_t chunkedRawClass;
+static R_altrep_class_t pooledRawClass;
+
+// A file mapping shared by the chromosomes of a population
+// It is unmapped when the last array using it is garbage collected
+struct GenoMapping{
+  void * addr;
+  size_t length;
+};
+
+static void finalizeGenoMapping(SEXP ptr){
+  GenoMapping * mapping = static_cast<GenoMapping*>(R_ExternalPtrAddr(ptr));
+  if(mapping != NULL){
+#ifndef _WIN32
+    munmap(mapping->addr, mapping->length);
+#endif
+    delete mapping;
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+// data1 is the mapping, data2 holds the offset and length of the array
+static unsigned char * mappedRawPtr(SEXP x){
+  GenoMapping * mapping =
+    static_cast<GenoMapping*>(R_ExternalPtrAddr(R_altrep_data1(x)));
+  if(mapping == NULL){
+    // Called from ALTREP methods, where a C++ exception can't unwind
+    Rf_error("File backed genotypes are no longer mapped");
+  }
+  return static_cast<unsigned char*>(mapping->addr) +
+    static_cast<size_t>(REAL(R_altrep_data2(x))[0]);
+}
+
+static R_xlen_t mappedRawLength(SEXP x){
+  return static_cast<R_xlen_t>(REAL(R_altrep_data2(x))[1]);
+}
+
+// Pages are mapped privately, so writes never reach the file
+static void * mappedRawDataptr(SEXP x, Rboolean writeable){
+  return mappedRawPtr(x);
+}
+
+static const void * mappedRawDataptrOrNull(SEXP x){
+  return mappedRawPtr(x);
+}
+
+static Rbyte mappedRawElt(SEXP x, R_xlen_t i){
+  return mappedRawPtr(x)[i];
+}
+
+static R_xlen_t mappedRawGetRegion(SEXP x, R_xlen_t i, R_xlen_t n,
+                                   Rbyte * buf){
+  R_xlen_t length = mappedRawLength(x);
+  R_xlen_t nCopy = (i+n > length) ? length-i : n;
+  if(nCopy > 0){
+    std::memcpy(buf, mappedRawPtr(x)+i, nCopy);
+  }
+  return nCopy;
+}
+
+static Rboolean mappedRawInspect(SEXP x, int pre, int deep, int pvec,
+                                 void (*inspect_subtree)(SEXP, int, int, int)){
+  Rprintf(" file backed raw (len=%.0f)\n", double(mappedRawLength(x)));
+  return TRUE;
+}
+
+// Chunked arrays concatenate the individuals of several arrays without
+// copying them. data1 is a list of the chunks and the cumulative start of
+// each chunk. data2 is the contiguous copy, created the first time a
+// pointer to the data is requested. The copy then replaces the chunks.
+static SEXP chunkedRawChunks(SEXP x){
+  return VECTOR_ELT(R_altrep_data1(x), 0);
+}
+
+static const double * chunkedRawStarts(SEXP x){
+  return REAL(VECTOR_ELT(R_altrep_data1(x), 1));
+}
+
+static R_xlen_t chunkedRawLength(SEXP x){
+  return static_cast<R_xlen_t>(chunkedRawStarts(x)[XLENGTH(chunkedRawChunks(x))]);
+}
+
+static SEXP chunkedRawMaterialize(SEXP x){
+  SEXP output = R_altrep_data2(x);
+  if(output == R_NilValue){
+    SEXP chunks = chunkedRawChunks(x);
+    output = PROTECT(Rf_allocVector(RAWSXP, chunkedRawLength(x)));
+    Rbyte * dest = RAW(output);
+    for(R_xlen_t i=0; i<XLENGTH(chunks); i++){
+      SEXP chunk = VECTOR_ELT(chunks, i);
+      RAW_GET_REGION(chunk, 0, XLENGTH(chunk), dest);
+      dest += XLENGTH(chunk);
+    }
+    R_set_altrep_data2(x, output);
+    // The copy becomes the only chunk, so the original chunks can be
+    // released
+    SEXP data1 = PROTECT(Rf_allocVector(VECSXP, 2));
+    SEXP single = PROTECT(Rf_allocVector(VECSXP, 1));
+    SET_VECTOR_ELT(single, 0, output);
+    SEXP starts = PROTECT(Rf_allocVector(REALSXP, 2));
+    REAL(starts)[0] = 0;
+    REAL(starts)[1] = double(XLENGTH(output));
+    SET_VECTOR_ELT(data1, 0, single);
+    SET_VECTOR_ELT(data1, 1, starts);
+    R_set_altrep_data1(x, data1);
+    UNPROTECT(4);
+  }
+  return output;
+}
+
+static void * chunkedRawDataptr(SEXP x, Rboolean writeable){
+  return RAW(chunkedRawMaterialize(x));
+}
+
+static const void * chunkedRawDataptrOrNull(SEXP x){
+  SEXP output = R_altrep_data2(x);
+  return (output == R_NilValue) ? NULL : RAW(output);
+}
+
+// Index of the chunk holding element i
+static R_xlen_t chunkedRawFind(SEXP x, R_xlen_t i){
+  const double * starts = chunkedRawStarts(x);
+  R_xlen_t nChunks = XLENGTH(chunkedRawChunks(x));
+  return std::upper_bound(starts, starts+nChunks, double(i)) - starts - 1;
+}
+
+static Rbyte chunkedRawElt(SEXP x, R_xlen_t i){
+  SEXP output = R_altrep_data2(x);
+  if(output != R_NilValue){
+    return RAW(output)[i];
+  }
+  R_xlen_t chunk = chunkedRawFind(x, i);
+  return RAW_ELT(VECTOR_ELT(chunkedRawChunks(x), chunk),
+                 i-static_cast<R_xlen_t>(chunkedRawStarts(x)[chunk]));
+}
+
+static R_xlen_t chunkedRawGetRegion(SEXP x, R_xlen_t i, R_xlen_t n,
+                                    Rbyte * buf){
+  R_xlen_t length = chunkedRawLength(x);
+  R_xlen_t nCopy = (i+n > length) ? length-i : n;
+  SEXP output = R_altrep_data2(x);
+  if(output != R_NilValue){
+    if(nCopy > 0){
+      std::memcpy(buf, RAW(output)+i, nCopy);
+    }
+    return nCopy;
+  }
+  SEXP chunks = chunkedRawChunks(x);
+  const double * starts = chunkedRawStarts(x);
+  R_xlen_t done = 0;
+  while(done < nCopy){
+    R_xlen_t chunk = chunkedRawFind(x, i+done);
+    SEXP src = VECTOR_ELT(chunks, chunk);
+    R_xlen_t first = i+done-static_cast<R_xlen_t>(starts[chunk]);
+    R_xlen_t nPart = std::min(nCopy-done, XLENGTH(src)-first);
+    done += RAW_GET_REGION(src, first, nPart, buf+done);
+  }
+  return nCopy;
+}
+
+// Copies share the chunks, which are never modified
+static SEXP chunkedRawDuplicate(SEXP x, Rboolean deep){
+  SEXP output = R_altrep_data2(x);
+  if(output != R_NilValue){
+    return Rf_duplicate(output);
+  }
+  return R_new_altrep(chunkedRawClass, R_altrep_data1(x), R_NilValue);
+}
+
+static Rboolean chunkedRawInspect(SEXP x, int pre, int deep, int pvec,
+                                  void (*inspect_subtree)(SEXP, int, int, int)){
+  Rprintf(" chunked raw (len=%.0f, chunks=%.0f, %s)\n", 
+          double(chunkedRawLength(x)), 
+          double(XLENGTH(chunkedRawChunks(x))),
+          (R_altrep_data2(x) == R_NilValue) ? "unmaterialized" : "materialized");
+  return TRUE;
+}
+
+// Pooled arrays store each distinct haplotype once. data1 is a list of
+// the pool, with one haplotype per nBins bytes, the pool index of every
+// haplotype in the array and nBins. data2 is the contiguous copy, created
+// the first time a pointer to the data is requested. The copy then 
+// replaces the pool.
+static const Rbyte * pooledRawPool(SEXP x){
+  return RAW(VECTOR_ELT(R_altrep_data1(x), 0));
+}
+
+static const int * pooledRawIndex(SEXP x){
+  return INTEGER(VECTOR_ELT(R_altrep_data1(x), 1));
+}
+
+static R_xlen_t pooledRawNBins(SEXP x){
+  return INTEGER(VECTOR_ELT(R_altrep_data1(x), 2))[0];
+}
+
+static R_xlen_t pooledRawLength(SEXP x){
+  return XLENGTH(VECTOR_ELT(R_altrep_data1(x), 1))*pooledRawNBins(x);
+}
+
+static SEXP pooledRawMaterialize(SEXP x){
+  SEXP output = R_altrep_data2(x);
+  if(output == R_NilValue){
+    R_xlen_t nBins = pooledRawNBins(x);
+    R_xlen_t nHap = XLENGTH(VECTOR_ELT(R_altrep_data1(x), 1));
+    output = PROTECT(Rf_allocVector(RAWSXP, nHap*nBins));
+    const Rbyte * pool = pooledRawPool(x);
+    const int * index = pooledRawIndex(x);
+    for(R_xlen_t i=0; i<nHap; i++){
+      std::memcpy(RAW(output)+i*nBins, pool+index[i]*nBins, nBins);
+    }
+    R_set_altrep_data2(x, output);
+    // The copy becomes the pool, with each haplotype indexing itself, 
+    // so the original pool can be released
+    SEXP data1 = PROTECT(Rf_allocVector(VECSXP, 3));
+    SEXP selfIndex = PROTECT(Rf_allocVector(INTSXP, nHap));
+    for(R_xlen_t i=0; i<nHap; i++){
+      INTEGER(selfIndex)[i] = int(i);
+    }
+    SET_VECTOR_ELT(data1, 0, output);
+    SET_VECTOR_ELT(data1, 1, selfIndex);
+    SET_VECTOR_ELT(data1, 2, VECTOR_ELT(R_altrep_data1(x), 2));
+    R_set_altrep_data1(x, data1);
+    UNPROTECT(3);
+  }
+  return output;
+}
+
+static void * pooledRawDataptr(SEXP x, Rboolean writeable){
+  return RAW(pooledRawMaterialize(x));
+}
+
+static const void * pooledRawDataptrOrNull(SEXP x){
+  SEXP output = R_altrep_data2(x);
+  return (output == R_NilValue) ? NULL : RAW(output);
+}
+
+static Rbyte pooledRawElt(SEXP x, R_xlen_t i){
+  SEXP output = R_altrep_data2(x);
+  if(output != R_NilValue){
+    return RAW(output)[i];
+  }
+  R_xlen_t nBins = pooledRawNBins(x);
+  return pooledRawPool(x)[pooledRawIndex(x)[i/nBins]*nBins + i%nBins];
+}
+
+static R_xlen_t pooledRawGetRegion(SEXP x, R_xlen_t i, R_xlen_t n,
+                                   Rbyte * buf){
+  R_xlen_t length = pooledRawLength(x);
+  R_xlen_t nCopy = (i+n > length) ? length-i : n;
+  SEXP output = R_altrep_data2(x);
+  if(output != R_NilValue){
+    if(nCopy > 0){
+      std::memcpy(buf, RAW(output)+i, nCopy);
+    }
+    return nCopy;
+  }
+  R_xlen_t nBins = pooledRawNBins(x);
+  const Rbyte * pool = pooledRawPool(x);
+  const int * index = pooledRawIndex(x);
+  R_xlen_t done = 0;
+  while(done < nCopy){
+    R_xlen_t hap = (i+done)/nBins;
+    R_xlen_t first = (i+done)%nBins;
+    R_xlen_t nPart = std::min(nCopy-done, nBins-first);
+    std::memcpy(buf+done, pool+index[hap]*nBins+first, nPart);
+    done += nPart;
+  }
+  return nCopy;
+}
+
+// Copies share the pool, which is never modified
+static SEXP pooledRawDuplicate(SEXP x, Rboolean deep){
+  SEXP output = R_altrep_data2(x);
+  if(output != R_NilValue){
+    return Rf_duplicate(output);
+  }
+  return R_new_altrep(pooledRawClass, R_altrep_data1(x), R_NilValue);
+}
+
+static Rboolean pooledRawInspect(SEXP x, int pre, int deep, int pvec,
+                                 void (*inspect_subtree)(SEXP, int, int, int)){
+  Rprintf(" pooled raw (len=%.0f, unique=%.0f, %s)\n", 
+          double(pooledRawLength(x)), 
+          double(XLENGTH(VECTOR_ELT(R_altrep_data1(x), 0))/
+            std::max(pooledRawNBins(x), R_xlen_t(1))),
+          (R_altrep_data2(x) == R_NilValue) ? "unmaterialized" : "materialized");
+  return TRUE;
+}
+
+// [[Rcpp::init]]
+void registerGenoStore(DllInfo* dll){
+  mappedRawClass = R_make_altraw_class("mappedRaw", "AlphaSimR", dll);
+  R_set_altrep_Length_method(mappedRawClass, mappedRawLength);
+  R_set_altrep_Inspect_method(mappedRawClass, mappedRawInspect);
+  R_set_altvec_Dataptr_method(mappedRawClass, mappedRawDataptr);
+  R_set_altvec_Dataptr_or_null_method(mappedRawClass, mappedRawDataptrOrNull);
+  R_set_altraw_Elt_method(mappedRawClass, mappedRawElt);
+  R_set_altraw_Get_region_method(mappedRawClass, mappedRawGetRegion);
+
+  chunkedRawClass = R_make_altraw_class("chunkedRaw", "AlphaSimR", dll);
+  R_set_altrep_Length_method(chunkedRawClass, chunkedRawLength);
+  R_set_altrep_Inspect_method(chunkedRawClass, chunkedRawInspect);
+  R_set_altrep_Duplicate_method(chunkedRawClass, chunkedRawDuplicate);
+  R_set_altvec_Dataptr_method(chunkedRawClass, chunkedRawDataptr);
+  R_set_altvec_Dataptr_or_null_method(chunkedRawClass, chunkedRawDataptrOrNull);
+  R_set_altraw_Elt_method(chunkedRawClass, chunkedRawElt);
+  R_set_altraw_Get_region_method(chunkedRawClass, chunkedRawGetRegion);
+
+  pooledRawClass = R_make_altraw_class("pooledRaw", "AlphaSimR", dll);
+  R_set_altrep_Length_method(pooledRawClass, pooledRawLength);
+  R_set_altrep_Inspect_method(pooledRawClass, pooledRawInspect);
+  R_set_altrep_Duplicate_method(pooledRawClass, pooledRawDuplicate);
+  R_set_altvec_Dataptr_method(pooledRawClass, pooledRawDataptr);
+  R_set_altvec_Dataptr_or_null_method(pooledRawClass, pooledRawDataptrOrNull);
+  R_set_altraw_Elt_method(pooledRawClass, pooledRawElt);
+  R_set_altraw_Get_region_method(pooledRawClass, pooledRawGetRegion);
+}
+
+// Writes the raw arrays in geno to filePath, each starting on a page
+// boundary, and returns a list of arrays backed by a mapping of the file.
+// The file is removed once mapped unless keepFile is true, in which
+// case the space is released when the mapping is.
+// [[Rcpp::export]]
+Rcpp::List mapGenoFile(Rcpp::List geno, Rcpp::String filePath,
+                       bool keepFile=false){
+#ifdef _WIN32
+  Rcpp::stop("File backed genotypes are not supported on Windows");
+  return geno;
+#else
+  R_xlen_t nChr = geno.size();
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  std::vector<size_t> offset(nChr), length(nChr);
+  size_t total = 0;
+  for(R_xlen_t chr=0; chr<nChr; chr++){
+    SEXP x = geno[chr];
+    if(TYPEOF(x) != RAWSXP){
+      Rcpp::stop("geno must be a list of raw arrays");
+    }
+    offset[chr] = total;
+    length[chr] = XLENGTH(x);
+    total += ((length[chr]+pageSize-1)/pageSize)*pageSize;
+  }
+  if(total == 0){
+    return geno;
+  }
+
+  // Write each chromosome padded to whole pages
+  std::ofstream file(filePath.get_cstring(), std::ios::binary | std::ios::trunc);
+  if(!file){
+    Rcpp::stop("Unable to open "+std::string(filePath.get_cstring()));
+  }
+  std::vector<char> padding(pageSize, 0);
+  for(R_xlen_t chr=0; chr<nChr; chr++){
+    SEXP x = geno[chr];
+    file.write(reinterpret_cast<const char*>(RAW(x)), length[chr]);
+    size_t nPad = (pageSize-length[chr]%pageSize)%pageSize;
+    file.write(&padding[0], nPad);
+  }
+  file.close();
+  if(!file){
+    std::remove(filePath.get_cstring());
+    Rcpp::stop("Unable to write "+std::string(filePath.get_cstring()));
+  }
+
+  int fd = open(filePath.get_cstring(), O_RDONLY);
+  if(fd < 0){
+    std::remove(filePath.get_cstring());
+    Rcpp::stop("Unable to open "+std::string(filePath.get_cstring()));
+  }
+  void * addr = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(!keepFile){
+    std::remove(filePath.get_cstring());
+  }
+  if(addr == MAP_FAILED){
+    Rcpp::stop("Unable to map "+std::string(filePath.get_cstring()));
+  }
+
+  GenoMapping * mapping = new GenoMapping;
+  mapping->addr = addr;
+  mapping->length = total;
+  Rcpp::RObject ptr = R_MakeExternalPtr(mapping, R_NilValue, R_NilValue);
+  R_RegisterCFinalizerEx(ptr, finalizeGenoMapping, TRUE);
+
+  Rcpp::List output(nChr);
+  for(R_xlen_t chr=0; chr<nChr; chr++){
+    Rcpp::NumericVector region = Rcpp::NumericVector::create(
+      double(offset[chr]), double(length[chr]));
+    Rcpp::RObject x = R_new_altrep(mappedRawClass, ptr, region);
+    SEXP dim = Rf_getAttrib(geno[chr], R_DimSymbol);
+    if(dim != R_NilValue){
+      Rf_setAttrib(x, R_DimSymbol, dim);
+    }
+    output[chr] = x;
+  }
+  return output;
+#endif
+}
+
+// Concatenates the individuals in the arrays of one chromosome
+// Unmaterialized chunked arrays contribute their chunks, so repeated
+// merging does not nest. A single chunk is returned as is.
+static SEXP mergeChr(const std::vector<SEXP> & parts, 
+                     int nBins, int ploidy){
+  // Chunks are protected by the arrays they come from
+  std::vector<SEXP> chunks;
+  double total = 0;
+  std::vector<double> starts;
+  int nInd = 0;
+  for(size_t i=0; i<parts.size(); i++){
+    SEXP x = parts[i];
+    SEXP xDim = Rf_getAttrib(x, R_DimSymbol);
+    if((xDim == R_NilValue) || (XLENGTH(xDim) != 3) ||
+       (INTEGER(xDim)[0] != nBins) || (INTEGER(xDim)[1] != ploidy)){
+      Rcpp::stop("Genotype arrays being merged must have the same number of bins and ploidy");
+    }
+    nInd += INTEGER(xDim)[2];
+    if(ALTREP(x) && R_altrep_inherits(x, chunkedRawClass) && 
+       (R_altrep_data2(x) == R_NilValue)){
+      SEXP inner = chunkedRawChunks(x);
+      for(R_xlen_t j=0; j<XLENGTH(inner); j++){
+        starts.push_back(total);
+        total += XLENGTH(VECTOR_ELT(inner, j));
+        chunks.push_back(VECTOR_ELT(inner, j));
+      }
+    }else if(XLENGTH(x) > 0){
+      starts.push_back(total);
+      total += XLENGTH(x);
+      chunks.push_back(x);
+    }
+  }
+  Rcpp::IntegerVector dim = Rcpp::IntegerVector::create(nBins, ploidy, nInd);
+  Rcpp::RObject output;
+  if(chunks.size() == 0){
+    output = Rf_allocVector(RAWSXP, 0);
+  }else if(chunks.size() == 1){
+    return chunks[0];
+  }else{
+    starts.push_back(total);
+    Rcpp::List chunkList(chunks.size());
+    for(size_t i=0; i<chunks.size(); i++){
+      chunkList[i] = chunks[i];
+    }
+    Rcpp::List data1 = Rcpp::List::create(chunkList, Rcpp::wrap(starts));
+    output = R_new_altrep(chunkedRawClass, data1, R_NilValue);
+  }
+  Rf_setAttrib(output, R_DimSymbol, dim);
+  return output;
+}
+
+// Merges geno objects, i.e. lists containing arrays of raw
+// [[Rcpp::export]]
+Rcpp::List mergeGeno(Rcpp::List x, Rcpp::List y){
+  R_xlen_t nChr = x.size();
+  Rcpp::List z(nChr);
+  for(R_xlen_t i=0; i<nChr; ++i){
+    std::vector<SEXP> parts(2);
+    parts[0] = x[i];
+    parts[1] = y[i];
+    SEXP dim = Rf_getAttrib(parts[0], R_DimSymbol);
+    if((dim == R_NilValue) || (XLENGTH(dim) != 3)){
+      Rcpp::stop("geno must be a list of 3 dimensional raw arrays");
+    }
+    z[i] = mergeChr(parts, INTEGER(dim)[0], INTEGER(dim)[1]);
+  }
+  return z;
+}
+
+// Merges multiple geno objects contained a list of Class-Pop
+// [[Rcpp::export]]
+Rcpp::List mergeMultGeno(Rcpp::List& popList,
+                         arma::uvec nBin,
+                         arma::uword ploidy){
+  Rcpp::List output(nBin.n_elem);
+  std::vector<Rcpp::List> genoList;
+  for(R_xlen_t i=0; i<popList.size(); ++i){
+    Rcpp::S4 pop = popList[i];
+    genoList.push_back(pop.slot("geno"));
+  }
+  for(arma::uword chr=0; chr<nBin.n_elem; ++chr){
+    std::vector<SEXP> parts(genoList.size());
+    for(size_t i=0; i<genoList.size(); ++i){
+      parts[i] = genoList[i][chr];
+    }
+    output[chr] = mergeChr(parts, nBin(chr), ploidy);
+  }
+  return output;
+}
+
+// Appends a pointer to each haplotype of x, looking through unmaterialized
+// chunked and pooled arrays
+static void appendHaplos(SEXP x, arma::uword nBins,
+                         std::vector<const unsigned char*> & haplos){
+  if(ALTREP(x) && (R_altrep_data2(x) == R_NilValue) && 
+     R_altrep_inherits(x, chunkedRawClass)){
+    SEXP chunks = chunkedRawChunks(x);
+    for(R_xlen_t i=0; i<XLENGTH(chunks); i++){
+      appendHaplos(VECTOR_ELT(chunks, i), nBins, haplos);
+    }
+  }else if(ALTREP(x) && (R_altrep_data2(x) == R_NilValue) && 
+           R_altrep_inherits(x, pooledRawClass)){
+    const Rbyte * pool = pooledRawPool(x);
+    const int * index = pooledRawIndex(x);
+    R_xlen_t nHap = XLENGTH(VECTOR_ELT(R_altrep_data1(x), 1));
+    for(R_xlen_t i=0; i<nHap; i++){
+      haplos.push_back(pool+index[i]*nBins);
+    }
+  }else{
+    SEXP dim = Rf_getAttrib(x, R_DimSymbol);
+    if((TYPEOF(x) != RAWSXP) || (Rf_length(dim) != 3)){
+      Rcpp::stop("geno must be a list of 3 dimensional raw arrays");
+    }
+    R_xlen_t nHap = R_xlen_t(INTEGER(dim)[1])*INTEGER(dim)[2];
+    const unsigned char * base = (nHap > 0) ? RAW(x) : NULL;
+    for(R_xlen_t i=0; i<nHap; i++){
+      haplos.push_back(base+i*nBins);
+    }
+  }
+}
+
+GenoView::GenoView(SEXP geno){
+  Rcpp::List genoList(geno);
+  nChr = genoList.size();
+  nBins.resize(nChr);
+  haplos.resize(nChr);
+  ploidy = 0;
+  nInd = 0;
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    SEXP x = genoList[chr];
+    SEXP dim = Rf_getAttrib(x, R_DimSymbol);
+    if((TYPEOF(x) != RAWSXP) || (Rf_length(dim) != 3)){
+      Rcpp::stop("geno must be a list of 3 dimensional raw arrays");
+    }
+    nBins[chr] = INTEGER(dim)[0];
+    ploidy = INTEGER(dim)[1];
+    nInd = INTEGER(dim)[2];
+    haplos[chr].reserve(ploidy*nInd);
+    appendHaplos(x, nBins[chr], haplos[chr]);
+  }
+}
+
+GenoView::GenoView(const arma::field<arma::Cube<unsigned char> >& geno){
+  nChr = geno.n_elem;
+  nBins.resize(nChr);
+  haplos.resize(nChr);
+  ploidy = (nChr > 0) ? geno(0).n_cols : 0;
+  nInd = (nChr > 0) ? geno(0).n_slices : 0;
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    nBins[chr] = geno(chr).n_rows;
+    haplos[chr].resize(ploidy*nInd);
+    for(arma::uword ind=0; ind<nInd; ++ind){
+      for(arma::uword p=0; p<ploidy; ++p){
+        haplos[chr][p+ploidy*ind] = geno(chr).slice_colptr(ind, p);
+      }
+    }
+  }
+}
+
+// Replaces each chromosome of geno with a pooled array if it contains
+// duplicated haplotypes. Haplotypes are grouped by a hash of their
+// bytes, which is computed in parallel, and compared in full before
+// being merged.
+// [[Rcpp::export]]
+Rcpp::List poolGeno(SEXP geno, int nThreads){
+  GenoView view(geno);
+  Rcpp::List genoList(geno);
+  Rcpp::List output(view.nChr);
+  for(arma::uword chr=0; chr<view.nChr; ++chr){
+    arma::uword nBins = view.nBins[chr];
+    arma::uword nHap = view.ploidy*view.nInd;
+    output[chr] = genoList[chr];
+    if((nBins == 0) || (nHap < 2)){
+      continue;
+    }
+    // FNV-1a hash of each haplotype
+    std::vector<uint64_t> hash(nHap);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for(arma::uword i=0; i<nHap; ++i){
+      const unsigned char * haplo = view.haplo(chr, i%view.ploidy, i/view.ploidy);
+      uint64_t h = 14695981039346656037ULL;
+      for(arma::uword j=0; j<nBins; ++j){
+        h = (h^haplo[j])*1099511628211ULL;
+      }
+      hash[i] = h;
+    }
+    std::unordered_map<uint64_t, std::vector<int> > buckets;
+    Rcpp::IntegerVector index(nHap);
+    std::vector<arma::uword> unique;
+    for(arma::uword i=0; i<nHap; ++i){
+      const unsigned char * haplo = view.haplo(chr, i%view.ploidy, i/view.ploidy);
+      std::vector<int> & bucket = buckets[hash[i]];
+      index[i] = -1;
+      for(size_t k=0; k<bucket.size(); ++k){
+        arma::uword u = unique[bucket[k]];
+        if(std::memcmp(haplo, view.haplo(chr, u%view.ploidy, u/view.ploidy), 
+                       nBins) == 0){
+          index[i] = bucket[k];
+          break;
+        }
+      }
+      if(index[i] < 0){
+        index[i] = unique.size();
+        bucket.push_back(unique.size());
+        unique.push_back(i);
+      }
+    }
+    if(unique.size() == nHap){
+      continue;
+    }
+    Rcpp::RawVector pool(unique.size()*nBins);
+    for(size_t k=0; k<unique.size(); ++k){
+      std::memcpy(&pool[k*nBins], 
+                  view.haplo(chr, unique[k]%view.ploidy, unique[k]/view.ploidy),
+                  nBins);
+    }
+    Rcpp::List data1 = Rcpp::List::create(pool, index, 
+                                          Rcpp::IntegerVector::create(nBins));
+    Rcpp::RObject x = R_new_altrep(pooledRawClass, data1, R_NilValue);
+    Rf_setAttrib(x, R_DimSymbol, Rf_getAttrib(genoList[chr], R_DimSymbol));
+    output[chr] = x;
+  }
+  return output;
+}
+
+// Returns a pooled array for inbred individuals, in which every 
+// haplotype of individual i is the i-th block of nBins bytes in gametes.
+// Calls the R API, so it can't be used in a parallel region.
+Rcpp::RObject poolInbredGeno(const unsigned char* gametes, arma::uword nBins,
+                             arma::uword ploidy, arma::uword nInd){
+  Rcpp::RawVector pool(nBins*nInd);
+  if(pool.size() > 0){
+    std::memcpy(&pool[0], gametes, nBins*nInd);
+  }
+  Rcpp::IntegerVector index(ploidy*nInd);
+  for(arma::uword i=0; i<ploidy*nInd; ++i){
+    index[i] = i/ploidy;
+  }
+  Rcpp::List data1 = Rcpp::List::create(pool, index, 
+                                        Rcpp::IntegerVector::create(nBins));
+  Rcpp::RObject x = R_new_altrep(pooledRawClass, data1, R_NilValue);
+  Rf_setAttrib(x, R_DimSymbol, 
+               Rcpp::IntegerVector::create(nBins, ploidy, nInd));
+  return x;
+}
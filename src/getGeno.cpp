@@ -6,16 +6,16 @@
  * Each cube has dimensions nLoci/8 by ploidy by nInd
  * Output returned with dimensions nInd by nLoci
  */
-// [[Rcpp::export]]
-arma::Mat<unsigned char> getGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
+// Sums the alleles of haplotypes firstHap to lastHap-1
+arma::Mat<unsigned char> sumGeno(const GenoView& geno, 
                                  const arma::Col<int>& lociPerChr,
-                                 arma::uvec lociLoc, int nThreads){
+                                 arma::uvec lociLoc, int nThreads,
+                                 arma::uword firstHap, arma::uword lastHap){
   // R to C++ index correction
   lociLoc -= 1;
   
-  arma::uword nInd = geno(0).n_slices;
-  arma::uword nChr = geno.n_elem;
-  arma::uword ploidy = geno(0).n_cols;
+  arma::uword nInd = geno.nInd;
+  arma::uword nChr = geno.nChr;
   if(nInd < static_cast<arma::uword>(nThreads) ){
     nThreads = nInd;
   }
@@ -34,15 +34,16 @@ arma::Mat<unsigned char> getGeno(const arma::field<arma::Cube<unsigned char> >&
       for(arma::uword ind=0; ind<nInd; ++ind){
         std::bitset<8> workBits;
         arma::uword currentByte, newByte;
-        for(arma::uword p=0; p<ploidy; ++p){
+        for(arma::uword p=firstHap; p<lastHap; ++p){
+          const unsigned char* haplo = geno.haplo(i,p,ind);
           currentByte = chrLociLoc(0)/8;
-          workBits = toBits(geno(i)(currentByte,p,ind));
+          workBits = toBits(haplo[currentByte]);
           output(ind,loc1) += (unsigned char) workBits[chrLociLoc(0)%8];
           for(arma::uword j=1; j<chrLociLoc.n_elem; ++j){
             newByte = chrLociLoc(j)/8;
             if(newByte != currentByte){
               currentByte = newByte;
-              workBits = toBits(geno(i)(currentByte,p,ind));
+              workBits = toBits(haplo[currentByte]);
             }
             output(ind,j+loc1) += (unsigned char) workBits[chrLociLoc(j)%8];
           }
@@ -53,6 +54,26 @@ arma::Mat<unsigned char> getGeno(const arma::field<arma::Cube<unsigned char> >&
   return output;
 }
 
+arma::Mat<unsigned char> getGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
+                                 const arma::Col<int>& lociPerChr,
+                                 arma::uvec lociLoc, int nThreads){
+  return getGeno(GenoView(geno), lociPerChr, lociLoc, nThreads);
+}
+
+arma::Mat<unsigned char> getGeno(const GenoView& geno, 
+                                 const arma::Col<int>& lociPerChr,
+                                 arma::uvec lociLoc, int nThreads){
+  return sumGeno(geno, lociPerChr, lociLoc, nThreads, 
+                 0, geno.ploidy);
+}
+
+// [[Rcpp::export]]
+arma::Mat<unsigned char> getGeno(SEXP geno, 
+                                 const arma::Col<int>& lociPerChr,
+                                 arma::uvec lociLoc, int nThreads){
+  return getGeno(GenoView(geno), lociPerChr, lociLoc, nThreads);
+}
+
 // Extracts genotypes for a specified subset of individuals (indVec)
 // The subset does not need to be ordered and is returned in the order submitted
 // // [[Rcpp::export]]
@@ -103,111 +124,56 @@ arma::Mat<unsigned char> getGeno(const arma::field<arma::Cube<unsigned char> >&
 //   return output;
 // }
 
-// [[Rcpp::export]]
 arma::Mat<unsigned char> getMaternalGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
                                          const arma::Col<int>& lociPerChr,
                                          arma::uvec lociLoc, int nThreads){
-  // R to C++ index correction
-  lociLoc -= 1;
-  
-  arma::uword nInd = geno(0).n_slices;
-  arma::uword nChr = geno.n_elem;
-  arma::uword ploidy = geno(0).n_cols;
-  if(nInd < static_cast<arma::uword>(nThreads) ){
-    nThreads = nInd;
-  }
-  arma::Mat<unsigned char> output(nInd,arma::sum(lociPerChr),arma::fill::zeros);
-  int loc1;
-  int loc2 = -1;
-  for(arma::uword i=0; i<nChr; ++i){
-    if(lociPerChr(i)>0){
-      // Get loci locations
-      loc1 = loc2+1;
-      loc2 += lociPerChr(i);
-      arma::uvec chrLociLoc = lociLoc(arma::span(loc1,loc2));
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) num_threads(nThreads)
-#endif
-      for(arma::uword ind=0; ind<nInd; ++ind){
-        std::bitset<8> workBits;
-        arma::uword currentByte, newByte;
-        for(arma::uword p=0; p<ploidy/2; ++p){
-          currentByte = chrLociLoc(0)/8;
-          workBits = toBits(geno(i)(currentByte,p,ind));
-          output(ind,loc1) += (unsigned char) workBits[chrLociLoc(0)%8];
-          for(arma::uword j=1; j<chrLociLoc.n_elem; ++j){
-            newByte = chrLociLoc(j)/8;
-            if(newByte != currentByte){
-              currentByte = newByte;
-              workBits = toBits(geno(i)(currentByte,p,ind));
-            }
-            output(ind,j+loc1) += (unsigned char) workBits[chrLociLoc(j)%8];
-          }
-        }
-      }
-    }
-  }
-  return output;
+  return getMaternalGeno(GenoView(geno), lociPerChr, lociLoc, nThreads);
+}
+
+arma::Mat<unsigned char> getMaternalGeno(const GenoView& geno, 
+                                         const arma::Col<int>& lociPerChr,
+                                         arma::uvec lociLoc, int nThreads){
+  return sumGeno(geno, lociPerChr, lociLoc, nThreads, 
+                 0, geno.ploidy/2);
 }
 
 // [[Rcpp::export]]
+arma::Mat<unsigned char> getMaternalGeno(SEXP geno, 
+                                         const arma::Col<int>& lociPerChr,
+                                         arma::uvec lociLoc, int nThreads){
+  return getMaternalGeno(GenoView(geno), lociPerChr, lociLoc, nThreads);
+}
+
 arma::Mat<unsigned char> getPaternalGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
                                          const arma::Col<int>& lociPerChr,
                                          arma::uvec lociLoc, int nThreads){
-  // R to C++ index correction
-  lociLoc -= 1;
-  
-  arma::uword nInd = geno(0).n_slices;
-  arma::uword nChr = geno.n_elem;
-  arma::uword ploidy = geno(0).n_cols;
-  if(nInd < static_cast<arma::uword>(nThreads) ){
-    nThreads = nInd;
-  }
-  arma::Mat<unsigned char> output(nInd,arma::sum(lociPerChr),arma::fill::zeros);
-  int loc1;
-  int loc2 = -1;
-  for(arma::uword i=0; i<nChr; ++i){
-    if(lociPerChr(i)>0){
-      // Get loci locations
-      loc1 = loc2+1;
-      loc2 += lociPerChr(i);
-      arma::uvec chrLociLoc = lociLoc(arma::span(loc1,loc2));
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) num_threads(nThreads)
-#endif
-      for(arma::uword ind=0; ind<nInd; ++ind){
-        std::bitset<8> workBits;
-        arma::uword currentByte, newByte;
-        for(arma::uword p=ploidy/2; p<ploidy; ++p){
-          currentByte = chrLociLoc(0)/8;
-          workBits = toBits(geno(i)(currentByte,p,ind));
-          output(ind,loc1) += (unsigned char) workBits[chrLociLoc(0)%8];
-          for(arma::uword j=1; j<chrLociLoc.n_elem; ++j){
-            newByte = chrLociLoc(j)/8;
-            if(newByte != currentByte){
-              currentByte = newByte;
-              workBits = toBits(geno(i)(currentByte,p,ind));
-            }
-            output(ind,j+loc1) += (unsigned char) workBits[chrLociLoc(j)%8];
-          }
-        }
-      }
-    }
-  }
-  return output;
+  return getPaternalGeno(GenoView(geno), lociPerChr, lociLoc, nThreads);
+}
+
+arma::Mat<unsigned char> getPaternalGeno(const GenoView& geno, 
+                                         const arma::Col<int>& lociPerChr,
+                                         arma::uvec lociLoc, int nThreads){
+  return sumGeno(geno, lociPerChr, lociLoc, nThreads, 
+                 geno.ploidy/2, geno.ploidy);
 }
 
-// Returns haplotype data in a matrix of nInd*ploidy by nLoci
 // [[Rcpp::export]]
-arma::Mat<unsigned char> getHaplo(const arma::field<arma::Cube<unsigned char> >& geno, 
+arma::Mat<unsigned char> getPaternalGeno(SEXP geno, 
+                                         const arma::Col<int>& lociPerChr,
+                                         arma::uvec lociLoc, int nThreads){
+  return getPaternalGeno(GenoView(geno), lociPerChr, lociLoc, nThreads);
+}
+
+// Returns haplotype data in a matrix of nInd*ploidy by nLoci
+arma::Mat<unsigned char> getHaplo(const GenoView& geno, 
                                   const arma::Col<int>& lociPerChr,
                                   arma::uvec lociLoc, int nThreads){
   // R to C++ index correction
   lociLoc -= 1;
   
-  arma::uword nInd = geno(0).n_slices;
-  arma::uword nChr = geno.n_elem;
-  arma::uword ploidy = geno(0).n_cols;
+  arma::uword nInd = geno.nInd;
+  arma::uword nChr = geno.nChr;
+  arma::uword ploidy = geno.ploidy;
   if(nInd < static_cast<arma::uword>(nThreads) ){
     nThreads = nInd;
   }
@@ -227,14 +193,15 @@ arma::Mat<unsigned char> getHaplo(const arma::field<arma::Cube<unsigned char> >&
         std::bitset<8> workBits;
         arma::uword currentByte, newByte;
         for(arma::uword p=0; p<ploidy; ++p){
+          const unsigned char* haplo = geno.haplo(i,p,ind);
           currentByte = chrLociLoc(0)/8;
-          workBits = toBits(geno(i)(currentByte,p,ind));
+          workBits = toBits(haplo[currentByte]);
           output(ind*ploidy+p,loc1) = (unsigned char) workBits[chrLociLoc(0)%8];
           for(arma::uword j=1; j<chrLociLoc.n_elem; ++j){
             newByte = chrLociLoc(j)/8;
             if(newByte != currentByte){
               currentByte = newByte;
-              workBits = toBits(geno(i)(currentByte,p,ind));
+              workBits = toBits(haplo[currentByte]);
             }
             output(ind*ploidy+p,j+loc1) = (unsigned char) workBits[chrLociLoc(j)%8];
           }
@@ -245,18 +212,24 @@ arma::Mat<unsigned char> getHaplo(const arma::field<arma::Cube<unsigned char> >&
   return output;
 }
 
+// [[Rcpp::export]]
+arma::Mat<unsigned char> getHaplo(SEXP geno, 
+                                  const arma::Col<int>& lociPerChr,
+                                  arma::uvec lociLoc, int nThreads){
+  return getHaplo(GenoView(geno), lociPerChr, lociLoc, nThreads);
+}
+
 // Returns haplotype data in a matrix of nInd by nLoci for a single
 // chromosome group. i.e. just female or male chromosomes for diploids
-// [[Rcpp::export]]
-arma::Mat<unsigned char> getOneHaplo(const arma::field<arma::Cube<unsigned char> >& geno, 
+arma::Mat<unsigned char> getOneHaplo(const GenoView& geno, 
                                      const arma::Col<int>& lociPerChr,
                                      arma::uvec lociLoc, int haplo, int nThreads){
   // R to C++ index correction
   lociLoc -= 1;
   haplo -= 1;
   
-  arma::uword nInd = geno(0).n_slices;
-  arma::uword nChr = geno.n_elem;
+  arma::uword nInd = geno.nInd;
+  arma::uword nChr = geno.nChr;
   if(nInd < static_cast<arma::uword>(nThreads) ){
     nThreads = nInd;
   }
@@ -275,14 +248,15 @@ arma::Mat<unsigned char> getOneHaplo(const arma::field<arma::Cube<unsigned char>
       for(arma::uword ind=0; ind<nInd; ++ind){
         std::bitset<8> workBits;
         arma::uword currentByte, newByte;
+        const unsigned char* hap = geno.haplo(i,haplo,ind);
         currentByte = chrLociLoc(0)/8;
-        workBits = toBits(geno(i)(currentByte,haplo,ind));
+        workBits = toBits(hap[currentByte]);
         output(ind,loc1) = (unsigned char) workBits[chrLociLoc(0)%8];
         for(arma::uword j=1; j<chrLociLoc.n_elem; ++j){
           newByte = chrLociLoc(j)/8;
           if(newByte != currentByte){
             currentByte = newByte;
-            workBits = toBits(geno(i)(currentByte,haplo,ind));
+            workBits = toBits(hap[currentByte]);
           }
           output(ind,j+loc1) = (unsigned char) workBits[chrLociLoc(j)%8];
         }
@@ -292,6 +266,13 @@ arma::Mat<unsigned char> getOneHaplo(const arma::field<arma::Cube<unsigned char>
   return output;
 }
 
+// [[Rcpp::export]]
+arma::Mat<unsigned char> getOneHaplo(SEXP geno, 
+                                     const arma::Col<int>& lociPerChr,
+                                     arma::uvec lociLoc, int haplo, int nThreads){
+  return getOneHaplo(GenoView(geno), lociPerChr, lociLoc, haplo, nThreads);
+}
+
 // Manually sets haplotype data
 // [[Rcpp::export]]
 arma::field<arma::Cube<unsigned char> > setHaplo(arma::field<arma::Cube<unsigned char> > geno,
@@ -343,12 +324,12 @@ arma::field<arma::Cube<unsigned char> > setHaplo(arma::field<arma::Cube<unsigned
 }
 
 // [[Rcpp::export]]
-void writeGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
+void writeGeno(SEXP geno, 
                const arma::Col<int>& lociPerChr,
                arma::uvec lociLoc,
                Rcpp::String filePath, int nThreads){
   arma::Mat<unsigned char> output;
-  output = getGeno(geno,lociPerChr,lociLoc,nThreads);
+  output = getGeno(GenoView(geno),lociPerChr,lociLoc,nThreads);
   std::ofstream outFile;
   outFile.open(filePath, std::ios_base::app);
   output.save(outFile,arma::raw_ascii);
@@ -356,18 +337,364 @@ void writeGeno(const arma::field<arma::Cube<unsigned char> >& geno,
 }
 
 // [[Rcpp::export]]
-void writeOneHaplo(const arma::field<arma::Cube<unsigned char> >& geno, 
+void writeOneHaplo(SEXP geno, 
                    const arma::Col<int>& lociPerChr, 
                    arma::uvec lociLoc, int haplo,
                    Rcpp::String filePath, int nThreads){
   arma::Mat<unsigned char> output;
-  output = getOneHaplo(geno,lociPerChr,lociLoc,haplo,nThreads);
+  output = getOneHaplo(GenoView(geno),lociPerChr,lociLoc,haplo,nThreads);
   std::ofstream outFile;
   outFile.open(filePath, std::ios_base::app);
   output.save(outFile,arma::raw_ascii);
   outFile.close();
 }
 
+/*
+ * Binary records are appended to a single file, one block per call.
+ * Each block has a header, the genetic values and phenotypes, the 
+ * haplotypes in chunks of markers and a footer indexing the chunks:
+ *   "ASRB", version, nInd, nMarkers, ploidy, nTraits, chunkSize
+ *   gv and pheno, nInd by nTraits doubles each
+ *   chunks, bit packed haplotypes laid out like a genotype cube
+ *   header offset, chunk offsets, footer offset, "ASRE"
+ * Integers are 64 bit and all values use the native byte order. Blocks 
+ * are found by following the footers back from the end of the file.
+ */
+const char recordStart[4] = {'A','S','R','B'};
+const char recordEnd[4] = {'A','S','R','E'};
+const uint64_t recordVersion = 1;
+
+// Appends a block of binary records
+// [[Rcpp::export]]
+void writeRecordsBin(SEXP genoList, 
+                     const arma::Col<int>& lociPerChr,
+                     arma::uvec lociLoc,
+                     const arma::mat& gv,
+                     const arma::mat& pheno,
+                     Rcpp::String filePath, int nThreads,
+                     arma::uword chunkSize=4096){
+  // R to C++ index correction
+  lociLoc -= 1;
+  
+  GenoView geno(genoList);
+  uint64_t nInd = geno.nInd;
+  uint64_t ploidy = geno.ploidy;
+  uint64_t nMarkers = lociLoc.n_elem;
+  uint64_t nTraits = gv.n_cols;
+  uint64_t chunk = chunkSize;
+  arma::uword nChunks = nMarkers/chunkSize;
+  if((nMarkers%chunkSize) > 0){
+    ++nChunks;
+  }
+  
+  // Chromosome of each marker
+  arma::uvec lociChr(nMarkers);
+  arma::uword loc = 0;
+  for(arma::uword chr=0; chr<geno.nChr; ++chr){
+    for(int i=0; i<lociPerChr(chr); ++i){
+      lociChr(loc) = chr;
+      ++loc;
+    }
+  }
+  
+  // Chunks are packed in parallel
+  std::vector<std::vector<char> > buffer(nChunks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword c=0; c<nChunks; ++c){
+    arma::uword start = c*chunkSize;
+    arma::uword n = std::min(arma::uword(chunkSize), 
+                             arma::uword(nMarkers-start));
+    arma::uword nBins = n/8;
+    if((n%8) > 0){
+      ++nBins;
+    }
+    buffer[c].assign(nBins*ploidy*nInd, 0);
+    for(arma::uword ind=0; ind<nInd; ++ind){
+      for(arma::uword p=0; p<ploidy; ++p){
+        char* out = &buffer[c][nBins*(p+ploidy*ind)];
+        for(arma::uword k=0; k<n; ++k){
+          arma::uword chr = lociChr(start+k);
+          arma::uword locus = lociLoc(start+k);
+          if((geno.haplo(chr,p,ind)[locus/8]>>(locus%8))&1){
+            out[k/8] |= 1<<(k%8);
+          }
+        }
+      }
+    }
+  }
+  
+  std::ofstream outFile;
+  outFile.open(filePath, std::ios_base::out | std::ios_base::binary | 
+    std::ios_base::app);
+  if(!outFile.is_open()){
+    Rcpp::stop("Could not open " + std::string(filePath.get_cstring()));
+  }
+  outFile.seekp(0, std::ios_base::end);
+  uint64_t headerOffset = outFile.tellp();
+  outFile.write(recordStart, 4);
+  outFile.write((char*)&recordVersion, 8);
+  outFile.write((char*)&nInd, 8);
+  outFile.write((char*)&nMarkers, 8);
+  outFile.write((char*)&ploidy, 8);
+  outFile.write((char*)&nTraits, 8);
+  outFile.write((char*)&chunk, 8);
+  outFile.write((char*)gv.memptr(), 8*gv.n_elem);
+  outFile.write((char*)pheno.memptr(), 8*pheno.n_elem);
+  std::vector<uint64_t> chunkOffset(nChunks);
+  for(arma::uword c=0; c<nChunks; ++c){
+    chunkOffset[c] = outFile.tellp();
+    outFile.write(buffer[c].data(), buffer[c].size());
+    std::vector<char>().swap(buffer[c]);
+  }
+  uint64_t footerOffset = outFile.tellp();
+  outFile.write((char*)&headerOffset, 8);
+  if(nChunks > 0){
+    outFile.write((char*)chunkOffset.data(), 8*nChunks);
+  }
+  outFile.write((char*)&footerOffset, 8);
+  outFile.write(recordEnd, 4);
+  outFile.close();
+}
+
+// Reads selected blocks and markers of binary records
+// gen: blocks to read, all if empty
+// markers: markers to read, all if empty
+// Returns genotypes as packed cubes with markers in the order requested
+// [[Rcpp::export]]
+Rcpp::List readRecordsBin(Rcpp::String filePath, arma::uvec gen, 
+                          arma::uvec markers, int nThreads){
+  std::ifstream inFile;
+  inFile.open(filePath, std::ios_base::in | std::ios_base::binary);
+  if(!inFile.is_open()){
+    Rcpp::stop("Could not open " + std::string(filePath.get_cstring()));
+  }
+  
+  // Locate blocks from the footers
+  std::vector<uint64_t> blocks, footers;
+  inFile.seekg(0, std::ios_base::end);
+  uint64_t end = inFile.tellg();
+  char tag[4];
+  while(end > 0){
+    uint64_t footerOffset, headerOffset;
+    if(end < 12){
+      Rcpp::stop("Corrupt record file");
+    }
+    inFile.seekg(end-12);
+    inFile.read((char*)&footerOffset, 8);
+    inFile.read(tag, 4);
+    if(!std::equal(tag, tag+4, recordEnd) || (footerOffset >= end)){
+      Rcpp::stop("Corrupt record file");
+    }
+    inFile.seekg(footerOffset);
+    inFile.read((char*)&headerOffset, 8);
+    // Each block must end after it starts, otherwise the walk would
+    // never reach the start of the file
+    if(!inFile || (headerOffset >= footerOffset)){
+      Rcpp::stop("Corrupt record file");
+    }
+    blocks.push_back(headerOffset);
+    footers.push_back(footerOffset);
+    end = headerOffset;
+  }
+  std::reverse(blocks.begin(), blocks.end());
+  std::reverse(footers.begin(), footers.end());
+  
+  if(gen.n_elem == 0){
+    gen.set_size(blocks.size());
+    for(arma::uword i=0; i<blocks.size(); ++i)
+      gen(i) = i+1;
+  }
+  arma::uword nGen = gen.n_elem;
+  arma::field<arma::Cube<unsigned char> > geno(nGen);
+  arma::field<arma::mat> gv(nGen), pheno(nGen);
+  arma::uvec nSelMarkers(nGen);
+  for(arma::uword g=0; g<nGen; ++g){
+    if((gen(g) < 1) || (gen(g) > blocks.size())){
+      Rcpp::stop("Requested generation is not in the records");
+    }
+    uint64_t headerOffset = blocks[gen(g)-1];
+    uint64_t version, nInd, nMarkers, ploidy, nTraits, chunkSize;
+    inFile.seekg(headerOffset);
+    inFile.read(tag, 4);
+    if(!std::equal(tag, tag+4, recordStart)){
+      Rcpp::stop("Corrupt record file");
+    }
+    inFile.read((char*)&version, 8);
+    if(version != recordVersion){
+      Rcpp::stop("Unsupported record file version");
+    }
+    inFile.read((char*)&nInd, 8);
+    inFile.read((char*)&nMarkers, 8);
+    inFile.read((char*)&ploidy, 8);
+    inFile.read((char*)&nTraits, 8);
+    inFile.read((char*)&chunkSize, 8);
+    if(!inFile || (chunkSize == 0)){
+      Rcpp::stop("Corrupt record file");
+    }
+    gv(g).set_size(nInd, nTraits);
+    pheno(g).set_size(nInd, nTraits);
+    inFile.read((char*)gv(g).memptr(), 8*gv(g).n_elem);
+    inFile.read((char*)pheno(g).memptr(), 8*pheno(g).n_elem);
+    
+    // Chunk offsets from the footer
+    arma::uword nChunks = nMarkers/chunkSize;
+    if((nMarkers%chunkSize) > 0){
+      ++nChunks;
+    }
+    std::vector<uint64_t> chunkOffset(nChunks);
+    inFile.seekg(footers[gen(g)-1]+8);
+    if(nChunks > 0){
+      inFile.read((char*)chunkOffset.data(), 8*nChunks);
+    }
+    
+    // Selected markers
+    arma::uvec sel;
+    if(markers.n_elem == 0){
+      sel.set_size(nMarkers);
+      for(arma::uword i=0; i<nMarkers; ++i)
+        sel(i) = i;
+    }else{
+      sel = markers-1;
+      if(arma::any(sel >= nMarkers)){
+        Rcpp::stop("Requested marker is not in the records");
+      }
+    }
+    arma::uword nSel = sel.n_elem;
+    nSelMarkers(g) = nSel;
+    arma::uword nBins = nSel/8;
+    if((nSel%8) > 0){
+      ++nBins;
+    }
+    geno(g).zeros(nBins, ploidy, nInd);
+    
+    if(nSel == 0){
+      continue;
+    }
+    
+    // Read each needed chunk once and extract its markers
+    arma::uvec selChunk = sel/chunkSize;
+    arma::uvec chunks = arma::unique(selChunk);
+    std::vector<char> buffer;
+    for(arma::uword i=0; i<chunks.n_elem; ++i){
+      arma::uword c = chunks(i);
+      arma::uword n = std::min(arma::uword(chunkSize), 
+                               arma::uword(nMarkers-c*chunkSize));
+      arma::uword chunkBins = n/8;
+      if((n%8) > 0){
+        ++chunkBins;
+      }
+      buffer.resize(chunkBins*ploidy*nInd);
+      inFile.seekg(chunkOffset[c]);
+      inFile.read(buffer.data(), buffer.size());
+      arma::uvec take = arma::find(selChunk == c);
+      if(nInd < static_cast<uint64_t>(nThreads) ){
+        nThreads = nInd;
+      }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+      for(arma::uword ind=0; ind<nInd; ++ind){
+        for(arma::uword p=0; p<ploidy; ++p){
+          const char* in = &buffer[chunkBins*(p+ploidy*ind)];
+          unsigned char* out = geno(g).slice_colptr(ind, p);
+          for(arma::uword j=0; j<take.n_elem; ++j){
+            arma::uword k = sel(take(j))-c*chunkSize;
+            if((in[k/8]>>(k%8))&1){
+              out[take(j)/8] |= 1<<(take(j)%8);
+            }
+          }
+        }
+      }
+    }
+  }
+  inFile.close();
+  return Rcpp::List::create(Rcpp::Named("geno")=geno,
+                            Rcpp::Named("nMarkers")=nSelMarkers,
+                            Rcpp::Named("gv")=gv,
+                            Rcpp::Named("pheno")=pheno);
+}
+
+// Writes genotypes in PLINK's binary SNP-major .bed format. Loci are 
+// encoded in chunks of about 16 MB, each chunk is filled in parallel 
+// across blocks of four individuals and then written with a single call. 
+// Allele 0 is PLINK's first allele, allele 1 the second.
+// [[Rcpp::export]]
+void writeBed(SEXP genoList, 
+              const arma::Col<int>& lociPerChr,
+              arma::uvec lociLoc,
+              Rcpp::String filePath, int nThreads){
+  // R to C++ index correction
+  lociLoc -= 1;
+  
+  GenoView geno(genoList);
+  if(geno.nInd == 0){
+    Rcpp::stop("writeBed requires at least one individual");
+  }
+  arma::uword nInd = geno.nInd;
+  arma::uword nChr = geno.nChr;
+  if(geno.ploidy != 2){
+    Rcpp::stop("writeBed only supports ploidy=2");
+  }
+  arma::uword nLoci = lociLoc.n_elem;
+  // Bytes per locus, four individuals per byte
+  arma::uword nBytes = nInd/4;
+  if((nInd%4) > 0){
+    ++nBytes;
+  }
+  if(nBytes < static_cast<arma::uword>(nThreads) ){
+    nThreads = nBytes;
+  }
+  
+  // Chromosome of each locus
+  arma::uvec lociChr(nLoci);
+  arma::uword loc = 0;
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    for(int i=0; i<lociPerChr(chr); ++i){
+      lociChr(loc) = chr;
+      ++loc;
+    }
+  }
+  
+  std::ofstream outFile;
+  outFile.open(filePath, std::ios_base::out | std::ios_base::binary | 
+    std::ios_base::trunc);
+  if(!outFile.is_open()){
+    Rcpp::stop("Could not open " + std::string(filePath.get_cstring()));
+  }
+  // Magic number and SNP-major mode
+  const char header[3] = {0x6c, 0x1b, 0x01};
+  outFile.write(header, 3);
+  
+  // PLINK codes by allele dosage: 00 homozygous first allele, 
+  // 10 heterozygous, 11 homozygous second allele
+  const unsigned char code[3] = {0, 2, 3};
+  arma::uword chunkSize = std::max(arma::uword(1), (arma::uword(1)<<24)/nBytes);
+  std::vector<char> buffer;
+  for(arma::uword start=0; start<nLoci; start+=chunkSize){
+    arma::uword n = std::min(chunkSize, nLoci-start);
+    buffer.assign(n*nBytes, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for(arma::uword q=0; q<nBytes; ++q){
+      for(arma::uword s=0; (s<4) && ((4*q+s)<nInd); ++s){
+        arma::uword ind = 4*q+s;
+        for(arma::uword k=0; k<n; ++k){
+          arma::uword chr = lociChr(start+k);
+          arma::uword locus = lociLoc(start+k);
+          unsigned char dose = ((geno.haplo(chr,0,ind)[locus/8]>>(locus%8))&1) + 
+            ((geno.haplo(chr,1,ind)[locus/8]>>(locus%8))&1);
+          buffer[k*nBytes+q] |= code[dose]<<(2*s);
+        }
+      }
+    }
+    outFile.write(buffer.data(), buffer.size());
+  }
+  outFile.close();
+}
+
 arma::mat genoToGenoA(const arma::Mat<unsigned char>& geno, 
                       arma::uword ploidy, int nThreads){
   arma::mat output(geno.n_rows,geno.n_cols);
@@ -404,37 +731,180 @@ arma::mat genoToGenoD(const arma::Mat<unsigned char>& geno,
   return output;
 }
 
+// Spreads the 8 bits of a byte to the lowest bit of 8 byte lanes,
+// with bit k in lane k
+const uint64_t* spreadTable(){
+  static uint64_t table[256];
+  static bool init = false;
+#ifdef _OPENMP
+#pragma omp critical(spreadTable)
+#endif
+  {
+    if(!init){
+      for(uint64_t x=0; x<256; ++x){
+        uint64_t word = 0;
+        for(uint64_t k=0; k<8; ++k){
+          word |= ((x>>k)&1) << (8*k);
+        }
+        table[x] = word;
+      }
+      init = true;
+    }
+  }
+  return table;
+}
+
+// Adds byte lane counters to output columns, 8 loci per bin
+inline void flushLanes(std::vector<uint64_t>& acc, arma::uword nClass,
+                       arma::umat& output){
+  for(arma::uword i=0; i<acc.size(); ++i){
+    arma::uword bin = i/nClass;
+    arma::uword k = i%nClass;
+    for(arma::uword lane=0; lane<8; ++lane){
+      output(k,8*bin+lane) += (acc[i]>>(8*lane))&0xFF;
+    }
+    acc[i] = 0;
+  }
+}
+
+// Counts alleles or genotypes for individuals start to stop-1 at the
+// loci in bins of a chromosome. Each bin is counted with byte lane 
+// counters in a 64-bit word, one lane per locus, flushed before 
+// they overflow. With byDosage, a lane holds the dosage of an 
+// individual and class k is counted by the lanes equal to k.
+void countBlock(const GenoView& geno, arma::uword chr,
+                const std::vector<arma::uword>& bins, bool byDosage,
+                arma::uword start, arma::uword stop, arma::umat& output){
+  const uint64_t* spread = spreadTable();
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+  arma::uword ploidy = geno.ploidy;
+  arma::uword nBins = bins.size();
+  arma::uword nClass = byDosage ? ploidy+1 : 1;
+  std::vector<uint64_t> acc(nBins*nClass, 0);
+  output.zeros(nClass, 8*nBins);
+  arma::uword nAdded = 0;
+  for(arma::uword ind=start; ind<stop; ++ind){
+    if(byDosage){
+      for(arma::uword b=0; b<nBins; ++b){
+        uint64_t dosage = 0;
+        for(arma::uword p=0; p<ploidy; ++p){
+          dosage += spread[geno.haplo(chr,p,ind)[bins[b]]];
+        }
+        for(arma::uword k=0; k<nClass; ++k){
+          // Lanes equal to k are set to 1
+          uint64_t diff = dosage ^ (ones*k);
+          acc[b*nClass+k] += ones & ~((((diff&low7)+low7)|diff)>>7);
+        }
+      }
+      ++nAdded;
+    }else{
+      for(arma::uword p=0; p<ploidy; ++p){
+        const unsigned char* haplo = geno.haplo(chr,p,ind);
+        for(arma::uword b=0; b<nBins; ++b){
+          acc[b] += spread[haplo[bins[b]]];
+        }
+        if(++nAdded==255){
+          flushLanes(acc, nClass, output);
+          nAdded = 0;
+        }
+      }
+    }
+    if(nAdded==255){
+      flushLanes(acc, nClass, output);
+      nAdded = 0;
+    }
+  }
+  flushLanes(acc, nClass, output);
+}
+
+// Counts alleles, or individuals with each dosage when byDosage is 
+// true, at all loci in the selected bins of each chromosome. Output 
+// has a matrix for each chromosome with a column for each locus in 
+// the bins, 8 per bin. Chromosomes and blocks of individuals are 
+// counted in parallel.
+arma::field<arma::umat> countBins(const GenoView& geno,
+                                  const std::vector<std::vector<arma::uword> >& bins,
+                                  bool byDosage, int nThreads){
+  const arma::uword indBlock = 4080; // Multiple of 255
+  arma::uword nChr = geno.nChr;
+  arma::uword nBlocks = (geno.nInd+indBlock-1)/indBlock;
+  arma::field<arma::umat> output(nChr);
+  arma::field<arma::umat> partial(nChr*nBlocks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+#endif
+  for(arma::uword i=0; i<(nChr*nBlocks); ++i){
+    arma::uword chr = i/nBlocks;
+    arma::uword start = (i%nBlocks)*indBlock;
+    arma::uword stop = std::min(start+indBlock, geno.nInd);
+    countBlock(geno, chr, bins[chr], byDosage, start, stop, partial(i));
+  }
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    output(chr).zeros(byDosage ? geno.ploidy+1 : 1, 8*bins[chr].size());
+    for(arma::uword b=0; b<nBlocks; ++b){
+      output(chr) += partial(chr*nBlocks+b);
+    }
+  }
+  return output;
+}
+
+// Bins holding a set of loci and the column of each locus in the 
+// output of countBins
+std::vector<std::vector<arma::uword> > lociBins(const arma::Col<int>& lociPerChr,
+                                                const arma::uvec& lociLoc,
+                                                arma::uvec& column){
+  std::vector<std::vector<arma::uword> > bins(lociPerChr.n_elem);
+  column.set_size(lociLoc.n_elem);
+  arma::uword i = 0;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    for(int j=0; j<lociPerChr(chr); ++j, ++i){
+      arma::uword loc = lociLoc(i)-1; // R to C++
+      if(bins[chr].empty() || (bins[chr].back()!=loc/8)){
+        bins[chr].push_back(loc/8);
+      }
+      column(i) = 8*(bins[chr].size()-1) + loc%8;
+    }
+  }
+  return bins;
+}
+
 // Calculates genotype frequency for selected sites
 // Intended for use in setEBV with a targetPop
 // [[Rcpp::export]]
-arma::rowvec calcGenoFreq(const arma::field<arma::Cube<unsigned char> >& geno, 
+arma::rowvec calcGenoFreq(SEXP geno, 
                           const arma::Col<int>& lociPerChr,
                           arma::uvec lociLoc, int nThreads){
-  arma::uword ploidy = geno(0).n_cols;
-  arma::Mat<unsigned char> tmp = getGeno(geno,
-                                         lociPerChr,
-                                         lociLoc, nThreads);
-  arma::rowvec output = arma::mean(arma::conv_to<arma::mat>::from(tmp),
-                                   0)/ploidy;
-  return output;
+  GenoView view(geno);
+  arma::uvec column;
+  std::vector<std::vector<arma::uword> > bins = lociBins(lociPerChr, lociLoc, 
+                                                         column);
+  arma::field<arma::umat> counts = countBins(view, bins, false, nThreads);
+  arma::rowvec output(lociLoc.n_elem);
+  arma::uword i = 0;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    for(int j=0; j<lociPerChr(chr); ++j, ++i){
+      output(i) = double(counts(chr)(0,column(i)));
+    }
+  }
+  return output/double(view.ploidy*view.nInd);
 }
 
-// Calculates allele frequency on a single chromsome
+// Calculates allele frequencies at all sites on each chromosome
 // [[Rcpp::export]]
-arma::rowvec calcChrFreq(const arma::Cube<unsigned char>& geno){
-  arma::field<arma::Cube<unsigned char> > genoList(1);
-  genoList(0) = geno;
-  arma::uword nLoci = geno.n_rows*8;
-  arma::uword ploidy = geno.n_cols;
-  arma::Col<int> lociPerChr(1);
-  lociPerChr(0) = nLoci;
-  arma::uvec lociLoc(nLoci);
-  for(arma::uword i=0; i<nLoci; ++i)
-    lociLoc(i) = i+1;
-  arma::Mat<unsigned char> tmp = getGeno(genoList,
-                                         lociPerChr,
-                                         lociLoc, 1);
-  arma::rowvec output = arma::mean(arma::conv_to<arma::mat>::from(tmp),
-                                   0)/ploidy;
+arma::field<arma::rowvec> calcAlleleFreq(SEXP geno, int nThreads){
+  GenoView view(geno);
+  std::vector<std::vector<arma::uword> > bins(view.nChr);
+  for(arma::uword chr=0; chr<view.nChr; ++chr){
+    for(arma::uword b=0; b<view.nBins[chr]; ++b){
+      bins[chr].push_back(b);
+    }
+  }
+  arma::field<arma::umat> counts = countBins(view, bins, false, nThreads);
+  arma::field<arma::rowvec> output(view.nChr);
+  for(arma::uword chr=0; chr<view.nChr; ++chr){
+    output(chr) = arma::conv_to<arma::rowvec>::from(counts(chr))/
+      double(view.ploidy*view.nInd);
+  }
   return output;
 }
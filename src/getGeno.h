@@ -1,19 +1,83 @@
 #ifndef GETGENO_H
 #define GETGENO_H
 
+#include <vector>
+#include <stdint.h>
+
+// Transposes an 8x8 bit matrix with rows stored in the bytes of a
+// word, moving bit h of byte k to bit k of byte h
+inline uint64_t transposeBits(uint64_t x){
+  uint64_t t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
+// Read only view of pop@geno
+// Each haplotype is resolved to a pointer into the memory of the R
+// arrays, including chunked arrays from merged populations and pooled
+// arrays of deduplicated haplotypes, avoiding the copy made by
+// Rcpp::as<arma::field<arma::Cube<unsigned char> > >. The view is only
+// valid while the list it was created from is protected.
+class GenoView{
+public:
+  explicit GenoView(SEXP geno);
+  explicit GenoView(const arma::field<arma::Cube<unsigned char> >& geno);
+  // Packed haplotype p of individual ind on chromosome chr
+  const unsigned char* haplo(arma::uword chr, arma::uword p, 
+                             arma::uword ind) const{
+    return haplos[chr][p+ploidy*ind];
+  }
+  // The same haplotype as a column vector using the view's memory
+  arma::Col<unsigned char> haploCol(arma::uword chr, arma::uword p, 
+                                    arma::uword ind) const{
+    return arma::Col<unsigned char>(const_cast<unsigned char*>(haplo(chr,p,ind)),
+                                    nBins[chr], false, true);
+  }
+  arma::uword nChr, ploidy, nInd;
+  std::vector<arma::uword> nBins;
+private:
+  std::vector<std::vector<const unsigned char*> > haplos;
+  GenoView(const GenoView&);
+  GenoView& operator=(const GenoView&);
+};
+
+Rcpp::RObject poolInbredGeno(const unsigned char* gametes, arma::uword nBins,
+                             arma::uword ploidy, arma::uword nInd);
+
 arma::Mat<unsigned char> getGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
                                  const arma::Col<int>& lociPerChr,
                                  arma::uvec lociLoc, int nThreads);
 
+arma::Mat<unsigned char> getGeno(const GenoView& geno, 
+                                 const arma::Col<int>& lociPerChr,
+                                 arma::uvec lociLoc, int nThreads);
+
 arma::Mat<unsigned char> getMaternalGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
                                          const arma::Col<int>& lociPerChr,
                                          arma::uvec lociLoc, int nThreads);
 
+arma::Mat<unsigned char> getMaternalGeno(const GenoView& geno, 
+                                         const arma::Col<int>& lociPerChr,
+                                         arma::uvec lociLoc, int nThreads);
+
 arma::Mat<unsigned char> getPaternalGeno(const arma::field<arma::Cube<unsigned char> >& geno, 
                                          const arma::Col<int>& lociPerChr,
                                          arma::uvec lociLoc, int nThreads);
 
-arma::Mat<unsigned char> getOneHaplo(const arma::field<arma::Cube<unsigned char> >& geno, 
+arma::Mat<unsigned char> getPaternalGeno(const GenoView& geno, 
+                                         const arma::Col<int>& lociPerChr,
+                                         arma::uvec lociLoc, int nThreads);
+
+arma::Mat<unsigned char> getHaplo(const GenoView& geno, 
+                                  const arma::Col<int>& lociPerChr,
+                                  arma::uvec lociLoc, int nThreads);
+
+arma::Mat<unsigned char> getOneHaplo(const GenoView& geno, 
                                      const arma::Col<int>& lociPerChr,
                                      arma::uvec lociLoc, int haplo, int nThreads);
 
@@ -23,4 +87,12 @@ arma::mat genoToGenoA(const arma::Mat<unsigned char>& geno,
 arma::mat genoToGenoD(const arma::Mat<unsigned char>& geno, 
                       arma::uword ploidy, int nThreads);
 
+arma::field<arma::umat> countBins(const GenoView& geno,
+                                  const std::vector<std::vector<arma::uword> >& bins,
+                                  bool byDosage, int nThreads);
+
+std::vector<std::vector<arma::uword> > lociBins(const arma::Col<int>& lociPerChr,
+                                                const arma::uvec& lociLoc,
+                                                arma::uvec& column);
+
 #endif
\ No newline at end of file
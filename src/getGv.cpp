@@ -1,5 +1,7 @@
 #include "alphasimr.h"
 
+const arma::uword indBlock = 256;
+
 // Calculates genetic values for genomic predictions using parental origin
 arma::field<arma::vec> getGvA2(const Rcpp::S4& trait, 
                                const Rcpp::S4& pop, 
@@ -31,9 +33,9 @@ arma::field<arma::vec> getGvA2(const Rcpp::S4& trait,
     xd(i) = double(i)*(dP-double(i))*(2.0/dP)*(2.0/dP);
   
   
-  arma::Mat<unsigned char> maternalGeno = getMaternalGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(pop.slot("geno")), 
+  arma::Mat<unsigned char> maternalGeno = getMaternalGeno(GenoView(SEXP(pop.slot("geno"))), 
                                                           lociPerChr, lociLoc, nThreads);
-  arma::Mat<unsigned char> paternalGeno = getPaternalGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(pop.slot("geno")), 
+  arma::Mat<unsigned char> paternalGeno = getPaternalGeno(GenoView(SEXP(pop.slot("geno"))), 
                                                           lociPerChr, lociLoc, nThreads);
   
 #ifdef _OPENMP
@@ -75,27 +77,21 @@ arma::field<arma::vec> getGvE(const Rcpp::S4& trait,
   double dP = double(ploidy);
   const arma::Col<int>& lociPerChr = trait.slot("lociPerChr");
   arma::uvec lociLoc = trait.slot("lociLoc");
-  arma::mat E;
-  E = Rcpp::as<arma::mat>(trait.slot("epiEff"));
-  E.col(0) -= 1; //R to C++
-  E.col(1) -= 1; //R to C++
+  arma::mat E = Rcpp::as<arma::mat>(trait.slot("epiEff"));
   arma::vec a,d,g;
   a = Rcpp::as<arma::vec>(trait.slot("addEff"));
   if(hasD){
     d = Rcpp::as<arma::vec>(trait.slot("domEff"));
   }
-  arma::mat gv(nInd,nThreads),gxe;
-  gv.fill(double(trait.slot("intercept"))/double(nThreads));
+  arma::vec gv(nInd),gxe;
+  gv.fill(double(trait.slot("intercept")));
   if(hasGxe){
     g = Rcpp::as<arma::vec>(trait.slot("gxeEff"));
     output.set_size(2);
-    output(0).set_size(nInd);
-    output(1).set_size(nInd);
-    gxe.set_size(nInd,nThreads);
-    gxe.fill(double(trait.slot("gxeInt"))/double(nThreads));
+    gxe.set_size(nInd);
+    gxe.fill(double(trait.slot("gxeInt")));
   }else{
     output.set_size(1);
-    output(0).set_size(nInd);
   }
   arma::vec x(ploidy+1); // Genotype dossage
   for(arma::uword i=0; i<x.n_elem; ++i)
@@ -103,41 +99,46 @@ arma::field<arma::vec> getGvE(const Rcpp::S4& trait,
   arma::vec xa = (x-dP/2.0)*(2.0/dP);
   arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
   
-  arma::Mat<unsigned char> genoMat = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(pop.slot("geno")), 
+  arma::Mat<unsigned char> genoMat = getGeno(GenoView(SEXP(pop.slot("geno"))), 
                                              lociPerChr, lociLoc, nThreads);
   
-  //Loop through loci pairs
+  // Values of each pair of loci by their dosages
+  EpiLoci epi(E, 2, ploidy);
+  arma::mat gvTab(epi.nGeno,epi.nInt), gxeTab;
+  if(hasGxe){
+    gxeTab.set_size(epi.nGeno,epi.nInt);
+  }
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static) num_threads(nThreads)
 #endif
-  for(arma::uword i=0; i<E.n_rows; ++i){
-    arma::uword tid;
-#ifdef _OPENMP
-    tid = omp_get_thread_num();
-#else
-    tid = 0;
-#endif
-    for(arma::uword j=0; j<nInd; ++j){
-      if(hasD){
-        gv(j,tid) += a(E(i,0))*xa(genoMat(j,(E(i,0)))) + 
-          d(E(i,0))*xd(genoMat(j,(E(i,0)))) + 
-          a(E(i,1))*xa(genoMat(j,(E(i,1)))) + 
-          d(E(i,1))*xd(genoMat(j,(E(i,1)))) + 
-          E(i,2)*xa(genoMat(j,(E(i,0))))*xa(genoMat(j,(E(i,1))));
-      }else{
-        gv(j,tid) += a(E(i,0))*xa(genoMat(j,(E(i,0)))) + 
-          a(E(i,1))*xa(genoMat(j,(E(i,1)))) + 
-          E(i,2)*xa(genoMat(j,(E(i,0))))*xa(genoMat(j,(E(i,1))));
-      }
-      if(hasGxe){
-        gxe(j,tid) += g(E(i,0))*xa(genoMat(j,(E(i,0)))) + 
-          g(E(i,1))*xa(genoMat(j,(E(i,1))));
+  for(arma::uword i=0; i<epi.nInt; ++i){
+    arma::uword l1 = epi.loci(0,i);
+    arma::uword l2 = epi.loci(1,i);
+    for(arma::uword k=0; k<(ploidy+1); ++k){
+      for(arma::uword j=0; j<(ploidy+1); ++j){
+        arma::uword row = j+k*(ploidy+1);
+        gvTab(row,i) = a(l1)*xa(j) + a(l2)*xa(k) + 
+          epi.eff(i)*xa(j)*xa(k);
+        if(hasD){
+          gvTab(row,i) += d(l1)*xd(j) + d(l2)*xd(k);
+        }
+        if(hasGxe){
+          gxeTab(row,i) = g(l1)*xa(j) + g(l2)*xa(k);
+        }
       }
     }
   }
-  output(0) = sum(gv,1);
+  
+  std::vector<const arma::mat*> tables(1,&gvTab);
+  std::vector<arma::vec*> values(1,&gv);
   if(hasGxe){
-    output(1) = sum(gxe,1);
+    tables.push_back(&gxeTab);
+    values.push_back(&gxe);
+  }
+  epi.addValues(genoMat, tables, values, nThreads);
+  output(0) = gv;
+  if(hasGxe){
+    output(1) = gxe;
   }
   return output;
 }
@@ -189,7 +190,7 @@ arma::field<arma::vec> getGv(const Rcpp::S4& trait,
   arma::vec xa = (x-dP/2.0)*(2.0/dP);
   arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
   
-  arma::Mat<unsigned char> genoMat = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(pop.slot("geno")), 
+  arma::Mat<unsigned char> genoMat = getGeno(GenoView(SEXP(pop.slot("geno"))), 
                                              lociPerChr, lociLoc, nThreads);
   
 #ifdef _OPENMP
@@ -223,3 +224,142 @@ arma::field<arma::vec> getGv(const Rcpp::S4& trait,
   }
   return output;
 }
+
+// Calculates genetic values for several traits, decoding each QTL
+// once. QTL are pooled across traits and each locus gets a small
+// table of effects by dosage with one column per trait and GxE
+// term. Traits with epistasis or parent of origin effects are passed
+// to getGv.
+// Returns a list with the output of getGv for each trait
+// [[Rcpp::export]]
+Rcpp::List getGvMulti(Rcpp::List traits, 
+                      const Rcpp::S4& pop, 
+                      int nThreads){
+  arma::uword nTraits = traits.size();
+  Rcpp::List output(nTraits);
+  arma::uword nInd = pop.slot("nInd");
+  arma::uword ploidy = pop.slot("ploidy");
+  arma::uword nChr = pop.slot("nChr");
+  double dP = double(ploidy);
+  arma::vec x(ploidy+1); // Genotype dossage
+  for(arma::uword i=0; i<x.n_elem; ++i)
+    x(i) = double(i);
+  arma::vec xa = (x-dP/2.0)*(2.0/dP);
+  arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
+  
+  // Column of each trait's genetic values and GxE effects
+  std::vector<arma::uword> batch;
+  std::vector<int> gvCol(nTraits,-1), gxeCol(nTraits,-1);
+  arma::uword nCol = 0;
+  // Union of QTL as chromosome and position pairs
+  std::vector<std::pair<arma::uword,arma::uword> > loci;
+  for(arma::uword t=0; t<nTraits; ++t){
+    Rcpp::S4 trait = traits[t];
+    if(trait.hasSlot("addEffMale") || trait.hasSlot("epiEff")){
+      output[t] = Rcpp::wrap(getGv(trait, pop, nThreads));
+      continue;
+    }
+    batch.push_back(t);
+    gvCol[t] = nCol++;
+    if(trait.hasSlot("gxeEff")){
+      gxeCol[t] = nCol++;
+    }
+    const arma::Col<int>& lociPerChr = trait.slot("lociPerChr");
+    arma::uvec lociLoc = trait.slot("lociLoc");
+    arma::uword k = 0;
+    for(arma::uword chr=0; chr<nChr; ++chr){
+      for(int i=0; i<lociPerChr(chr); ++i, ++k){
+        loci.push_back(std::make_pair(chr, lociLoc(k)));
+      }
+    }
+  }
+  if(batch.empty()){
+    return output;
+  }
+  std::sort(loci.begin(), loci.end());
+  loci.erase(std::unique(loci.begin(), loci.end()), loci.end());
+  arma::uword nLoci = loci.size();
+  arma::Col<int> lociPerChr(nChr,arma::fill::zeros);
+  arma::uvec lociLoc(nLoci);
+  for(arma::uword i=0; i<nLoci; ++i){
+    lociPerChr(loci[i].first) += 1;
+    lociLoc(i) = loci[i].second;
+  }
+  
+  // Effects by dosage for each locus, stored as nCol x (ploidy+1)
+  arma::cube eff(nCol,ploidy+1,nLoci,arma::fill::zeros);
+  arma::vec intercept(nCol,arma::fill::zeros);
+  for(arma::uword b=0; b<batch.size(); ++b){
+    Rcpp::S4 trait = traits[batch[b]];
+    const arma::Col<int>& traitLociPerChr = trait.slot("lociPerChr");
+    arma::uvec traitLociLoc = trait.slot("lociLoc");
+    arma::vec a,d,g;
+    a = Rcpp::as<arma::vec>(trait.slot("addEff"));
+    bool hasD = trait.hasSlot("domEff");
+    bool hasGxe = gxeCol[batch[b]]>=0;
+    if(hasD){
+      d = Rcpp::as<arma::vec>(trait.slot("domEff"));
+    }
+    intercept(gvCol[batch[b]]) = double(trait.slot("intercept"));
+    if(hasGxe){
+      g = Rcpp::as<arma::vec>(trait.slot("gxeEff"));
+      intercept(gxeCol[batch[b]]) = double(trait.slot("gxeInt"));
+    }
+    arma::uword k = 0;
+    for(arma::uword chr=0; chr<nChr; ++chr){
+      for(int i=0; i<traitLociPerChr(chr); ++i, ++k){
+        arma::uword u = std::lower_bound(loci.begin(), loci.end(),
+                                         std::make_pair(chr, traitLociLoc(k))) - 
+          loci.begin();
+        for(arma::uword dose=0; dose<=ploidy; ++dose){
+          eff(gvCol[batch[b]],dose,u) += xa(dose)*a(k);
+          if(hasD){
+            eff(gvCol[batch[b]],dose,u) += xd(dose)*d(k);
+          }
+          if(hasGxe){
+            eff(gxeCol[batch[b]],dose,u) += xa(dose)*g(k);
+          }
+        }
+      }
+    }
+  }
+  
+  arma::Mat<unsigned char> genoMat = getGeno(GenoView(SEXP(pop.slot("geno"))), 
+                                             lociPerChr, lociLoc, nThreads);
+  
+  // Values are accumulated for blocks of individuals, so each 
+  // individual is only updated by one thread. Every locus adds the 
+  // effects column of an individual's dosage to its nCol values.
+  arma::mat total(nCol,nInd);
+  total.each_col() = intercept;
+  arma::uword nBlocks = (nInd+indBlock-1)/indBlock;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword b=0; b<nBlocks; ++b){
+    arma::uword start = b*indBlock;
+    arma::uword stop = std::min(start+indBlock,nInd);
+    for(arma::uword i=0; i<nLoci; ++i){
+      const arma::mat& locusEff = eff.slice(i);
+      const unsigned char* dosage = genoMat.colptr(i);
+      for(arma::uword j=start; j<stop; ++j){
+        const double* e = locusEff.colptr(dosage[j]);
+        double* out = total.colptr(j);
+        for(arma::uword c=0; c<nCol; ++c){
+          out[c] += e[c];
+        }
+      }
+    }
+  }
+  
+  for(arma::uword b=0; b<batch.size(); ++b){
+    arma::uword t = batch[b];
+    arma::field<arma::vec> traitOutput(gxeCol[t]>=0 ? 2 : 1);
+    traitOutput(0) = total.row(gvCol[t]).t();
+    if(gxeCol[t]>=0){
+      traitOutput(1) = total.row(gxeCol[t]).t();
+    }
+    output[t] = Rcpp::wrap(traitOutput);
+  }
+  return output;
+}
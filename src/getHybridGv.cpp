@@ -48,9 +48,9 @@ arma::field<arma::vec> getHybridGvE(const Rcpp::S4& trait,
   arma::vec xa = (x-dP/2.0)*(2.0/dP);
   arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
   
-  arma::Mat<unsigned char> femaleGeno = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(females.slot("geno")), 
+  arma::Mat<unsigned char> femaleGeno = getGeno(GenoView(SEXP(females.slot("geno"))), 
                                                 lociPerChr, lociLoc, nThreads);
-  arma::Mat<unsigned char> maleGeno = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(males.slot("geno")), 
+  arma::Mat<unsigned char> maleGeno = getGeno(GenoView(SEXP(males.slot("geno"))), 
                                               lociPerChr, lociLoc, nThreads);
   
   //Loop through loci pairs
@@ -147,9 +147,9 @@ arma::field<arma::vec> getHybridGv(const Rcpp::S4& trait,
   arma::vec xa = (x-dP/2.0)*(2.0/dP);
   arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
   
-  arma::Mat<unsigned char> femaleGeno = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(females.slot("geno")), 
+  arma::Mat<unsigned char> femaleGeno = getGeno(GenoView(SEXP(females.slot("geno"))), 
                                                 lociPerChr, lociLoc, nThreads);
-  arma::Mat<unsigned char> maleGeno = getGeno(Rcpp::as<arma::field<arma::Cube<unsigned char> > >(males.slot("geno")), 
+  arma::Mat<unsigned char> maleGeno = getGeno(GenoView(SEXP(males.slot("geno"))), 
                                               lociPerChr, lociLoc, nThreads);
   
 #ifdef _OPENMP
@@ -185,4 +185,127 @@ arma::field<arma::vec> getHybridGv(const Rcpp::S4& trait,
     output(1) = sum(gxe,1);
   }
   return output;
-}
\ No newline at end of file
+}
+
+// Sums effects over loci for all crosses between females and males.
+// eff has one column per locus giving the effect of each progeny
+// dosage. A locus adds eff(dF+dM) to a cross, which is the product
+// of a matrix with each female's effect for every male dosage and a
+// matrix indicating the dosage of each male. Loci are processed in
+// blocks with a GEMM per block, keeping only male dosages that occur.
+arma::mat factorialEff(const arma::Mat<unsigned char>& femaleGeno,
+                       const arma::Mat<unsigned char>& maleGeno,
+                       const arma::mat& eff,
+                       arma::uword ploidyM,
+                       int nThreads){
+  arma::uword nFemale = femaleGeno.n_rows;
+  arma::uword nMale = maleGeno.n_rows;
+  arma::uword nLoci = eff.n_cols;
+  arma::mat output(nFemale,nMale,arma::fill::zeros);
+  const arma::uword blockSize = 256;
+  for(arma::uword start=0; start<nLoci; start+=blockSize){
+    arma::uword stop = std::min(start+blockSize,nLoci);
+    // Column of A and B for each locus and male dosage
+    std::vector<arma::uword> colLocus, colDose;
+    for(arma::uword i=start; i<stop; ++i){
+      std::vector<bool> present(ploidyM+1,false);
+      for(arma::uword m=0; m<nMale; ++m){
+        present[maleGeno(m,i)] = true;
+      }
+      for(arma::uword b=0; b<=ploidyM; ++b){
+        if(present[b]){
+          colLocus.push_back(i);
+          colDose.push_back(b);
+        }
+      }
+    }
+    arma::uword nCol = colLocus.size();
+    arma::mat A(nFemale,nCol), B(nMale,nCol);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for(arma::uword k=0; k<nCol; ++k){
+      arma::uword i = colLocus[k];
+      arma::uword b = colDose[k];
+      for(arma::uword f=0; f<nFemale; ++f){
+        A(f,k) = eff(femaleGeno(f,i)+b,i);
+      }
+      for(arma::uword m=0; m<nMale; ++m){
+        B(m,k) = (maleGeno(m,i)==b) ? 1.0 : 0.0;
+      }
+    }
+    output += A*B.t();
+  }
+  return output;
+}
+
+// Calculates genetic values for all crosses between females and males
+// Returns output in a list with length 1 or 2
+//   The first item contains an nFemale x nMale matrix of genetic values
+//   The second item contains GxE effects (optional)
+// [[Rcpp::export]]
+arma::field<arma::mat> getHybridGvFactorial(const Rcpp::S4& trait, 
+                                            const Rcpp::S4& females,
+                                            const Rcpp::S4& males,
+                                            int nThreads){
+  arma::uword nFemale = females.slot("nInd");
+  arma::uword nMale = males.slot("nInd");
+  arma::field<arma::mat> output;
+  if(trait.hasSlot("epiEff")){
+    // Epistasis isn't separable by locus, so crosses are listed
+    arma::uvec femaleParents(nFemale*nMale), maleParents(nFemale*nMale);
+    for(arma::uword f=0; f<nFemale; ++f){
+      for(arma::uword m=0; m<nMale; ++m){
+        femaleParents(f*nMale+m) = f+1;
+        maleParents(f*nMale+m) = m+1;
+      }
+    }
+    arma::field<arma::vec> tmp = getHybridGvE(trait, females, femaleParents,
+                                              males, maleParents, nThreads);
+    output.set_size(tmp.n_elem);
+    for(arma::uword i=0; i<tmp.n_elem; ++i){
+      output(i) = arma::reshape(tmp(i),nMale,nFemale).t();
+    }
+    return output;
+  }
+  bool hasD = trait.hasSlot("domEff");
+  bool hasGxe = trait.hasSlot("gxeEff");
+  arma::uword ploidyF = females.slot("ploidy");
+  arma::uword ploidyM = males.slot("ploidy");
+  // Calculate progeny ploidy without averaging
+  // I'm not averaging because AlphaSimR scales for different ploidy
+  arma::uword ploidy = ploidyF+ploidyM; 
+  double dP = double(ploidy);
+  const arma::Col<int>& lociPerChr = trait.slot("lociPerChr");
+  arma::uvec lociLoc = trait.slot("lociLoc");
+  arma::vec a,d,g;
+  a = Rcpp::as<arma::vec>(trait.slot("addEff"));
+  if(hasD){
+    d = Rcpp::as<arma::vec>(trait.slot("domEff"));
+  }
+  arma::vec x(ploidy+1); // Genotype dosage
+  for(arma::uword i=0; i<x.n_elem; ++i)
+    x(i) = double(i);
+  arma::vec xa = (x-dP/2.0)*(2.0/dP);
+  arma::vec xd = x%(dP-x)*(2.0/dP)*(2.0/dP);
+  
+  arma::Mat<unsigned char> femaleGeno = getGeno(GenoView(SEXP(females.slot("geno"))), 
+                                                lociPerChr, lociLoc, nThreads);
+  arma::Mat<unsigned char> maleGeno = getGeno(GenoView(SEXP(males.slot("geno"))), 
+                                              lociPerChr, lociLoc, nThreads);
+  
+  arma::mat eff = xa*a.t();
+  if(hasD){
+    eff += xd*d.t();
+  }
+  output.set_size(hasGxe ? 2 : 1);
+  output(0) = factorialEff(femaleGeno, maleGeno, eff, ploidyM, nThreads);
+  output(0) += double(trait.slot("intercept"));
+  if(hasGxe){
+    g = Rcpp::as<arma::vec>(trait.slot("gxeEff"));
+    arma::mat gEff = xa*g.t();
+    output(1) = factorialEff(femaleGeno, maleGeno, gEff, ploidyM, nThreads);
+    output(1) += double(trait.slot("gxeInt"));
+  }
+  return output;
+}
@@ -0,0 +1,535 @@
+#include <Rcpp.h>
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+#include "simulator.h"
+
+using namespace std;
+
+// FenwickTree
+
+FenwickTree::FenwickTree(){
+  iSize = 0;
+}
+
+void FenwickTree::resize(unsigned int iNewSize){
+  values.resize(iNewSize,0.);
+  iSize = iNewSize;
+  // rebuild in O(n)
+  tree.assign(iSize+1,0.);
+  for (unsigned int i=1;i<=iSize;++i){
+    tree[i] += values[i-1];
+    unsigned int j = i+(i&(-i));
+    if (j<=iSize) tree[j] += tree[i];
+  }
+}
+
+unsigned int FenwickTree::getSize(){
+  return iSize;
+}
+
+void FenwickTree::setValue(unsigned int index,double dValue){
+  double dDelta = dValue-values[index];
+  values[index] = dValue;
+  for (unsigned int i=index+1;i<=iSize;i+=(i&(-i))){
+    tree[i] += dDelta;
+  }
+}
+
+double FenwickTree::getValue(unsigned int index){
+  return values[index];
+}
+
+double FenwickTree::getCumulative(unsigned int index){
+  double dSum = 0.;
+  for (unsigned int i=index+1;i>0;i-=(i&(-i))){
+    dSum += tree[i];
+  }
+  return dSum;
+}
+
+double FenwickTree::getTotal(){
+  return iSize>0 ? getCumulative(iSize-1) : 0.;
+}
+
+unsigned int FenwickTree::find(double dValue){
+  unsigned int pos = 0;
+  unsigned int step = 1;
+  while ((step<<1)<=iSize) step <<= 1;
+  for (;step>0;step>>=1){
+    if (pos+step<=iSize && tree[pos+step]<=dValue){
+      pos += step;
+      dValue -= tree[pos];
+    }
+  }
+  // guard against rounding in the partial sums
+  if (pos>=iSize) pos = iSize-1;
+  return pos;
+}
+
+// HudsonBuilder
+
+HudsonBuilder::HudsonBuilder(Configuration * pConfig,
+                             RandNumGenerator * pRandNumGenerator,
+                             TreeSequence * pTreeSeq){
+  this->pConfig = pConfig;
+  this->pRandNumGenerator = pRandNumGenerator;
+  this->pTreeSeq = pTreeSeq;
+  this->dTime = 0.;
+  this->iTotalLineages = 0;
+  if (pConfig->bVariableRecomb){
+    throw "The Hudson simulator does not support recombination hot spots";
+  }
+  if (pConfig->dGeneConvRatio>0.){
+    throw "The Hudson simulator does not support gene conversion";
+  }
+  if (pConfig->bSNPAscertainment){
+    throw "The Hudson simulator does not support SNP ascertainment";
+  }
+  pPopList = pConfig->pPopList;
+  dMigrationMatrix = pConfig->dMigrationMatrix;
+  links.resize(1024);
+}
+
+int HudsonBuilder::allocSegment(double dLeft,double dRight,int iNode,int iPop){
+  int seg;
+  if (freeSegments.empty()){
+    seg = segLeft.size();
+    segLeft.push_back(dLeft);
+    segRight.push_back(dRight);
+    segNode.push_back(iNode);
+    segPrev.push_back(-1);
+    segNext.push_back(-1);
+    segPop.push_back(iPop);
+    lineageIndex.push_back(-1);
+    if (segLeft.size()>links.getSize()){
+      links.resize(2*links.getSize());
+    }
+  }else{
+    seg = freeSegments.back();
+    freeSegments.pop_back();
+    segLeft[seg] = dLeft;
+    segRight[seg] = dRight;
+    segNode[seg] = iNode;
+    segPrev[seg] = -1;
+    segNext[seg] = -1;
+    segPop[seg] = iPop;
+    lineageIndex[seg] = -1;
+  }
+  return seg;
+}
+
+void HudsonBuilder::freeSegment(int seg){
+  links.setValue(seg,0.);
+  freeSegments.push_back(seg);
+}
+
+void HudsonBuilder::setSegmentMass(int seg){
+  int prev = segPrev[seg];
+  double dLower = prev<0 ? segLeft[seg] : segRight[prev];
+  links.setValue(seg,segRight[seg]-dLower);
+}
+
+void HudsonBuilder::addLineage(int head,int pop){
+  lineageIndex[head] = popLineages[pop].size();
+  popLineages[pop].push_back(head);
+  ++iTotalLineages;
+}
+
+void HudsonBuilder::removeLineage(int head){
+  vector<int> & lineages = popLineages[segPop[head]];
+  int index = lineageIndex[head];
+  lineages[index] = lineages.back();
+  lineageIndex[lineages[index]] = index;
+  lineages.pop_back();
+  lineageIndex[head] = -1;
+  --iTotalLineages;
+}
+
+int HudsonBuilder::sampleLineage(int pop){
+  unsigned int n = popLineages[pop].size();
+  unsigned int i = static_cast<unsigned int>(pRandNumGenerator->unifRV()*n);
+  if (i>=n) i = n-1;
+  return popLineages[pop][i];
+}
+
+map<double,int>::iterator HudsonBuilder::getOverlapKey(double dPos){
+  map<double,int>::iterator it = overlapCounts.lower_bound(dPos);
+  if (it!=overlapCounts.end() && it->first==dPos){
+    return it;
+  }
+  --it;
+  return overlapCounts.insert(it,make_pair(dPos,it->second));
+}
+
+void HudsonBuilder::recombinationEvent(){
+  double h = pRandNumGenerator->unifRV()*links.getTotal();
+  int y = links.find(h);
+  int x = segPrev[y];
+  double k = segRight[y]-(links.getCumulative(y)-h);
+  int z;
+  if (segLeft[y]<k && k<segRight[y]){
+    // break point falls within segment y
+    z = allocSegment(k,segRight[y],segNode[y],segPop[y]);
+    segNext[z] = segNext[y];
+    if (segNext[y]>=0) segPrev[segNext[y]] = z;
+    segNext[y] = -1;
+    segRight[y] = k;
+    setSegmentMass(y);
+  }else if (x>=0){
+    // break point falls in the gap between x and y
+    segNext[x] = -1;
+    segPrev[y] = -1;
+    z = y;
+  }else{
+    // rounding put the break point outside the lineage
+    return;
+  }
+  setSegmentMass(z);
+  addLineage(z,segPop[z]);
+}
+
+void HudsonBuilder::coalescenceEvent(int pop){
+  int x = sampleLineage(pop);
+  removeLineage(x);
+  int y = sampleLineage(pop);
+  removeLineage(y);
+  int z = -1;
+  int iNewNode = -1;
+  while (x>=0 || y>=0){
+    int alpha = -1;
+    if (x<0 || y<0){
+      // the remainder of a single chain is carried over
+      alpha = x>=0 ? x : y;
+      x = y = -1;
+    }else{
+      if (segLeft[y]<segLeft[x]){
+        swap(x,y);
+      }
+      if (segRight[x]<=segLeft[y]){
+        // no overlap
+        alpha = x;
+        x = segNext[x];
+        segNext[alpha] = -1;
+      }else if (segLeft[x]!=segLeft[y]){
+        // x extends to the left of y
+        alpha = allocSegment(segLeft[x],segLeft[y],segNode[x],pop);
+        segLeft[x] = segLeft[y];
+      }else{
+        // overlapping material coalesces
+        if (iNewNode<0){
+          iNewNode = pTreeSeq->addNode(dTime);
+        }
+        double dLeft = segLeft[x];
+        double dMaxRight = min(segRight[x],segRight[y]);
+        map<double,int>::iterator it = getOverlapKey(dLeft);
+        getOverlapKey(dMaxRight);
+        double dRight;
+        if (it->second==2){
+          // the common ancestor of all samples, material is dropped
+          it->second = 0;
+          ++it;
+          dRight = it->first;
+        }else{
+          while (it->first<dMaxRight && it->second!=2){
+            --(it->second);
+            ++it;
+          }
+          dRight = it->first;
+          alpha = allocSegment(dLeft,dRight,iNewNode,pop);
+        }
+        pTreeSeq->addEdge(dLeft,dRight,iNewNode,segNode[x]);
+        pTreeSeq->addEdge(dLeft,dRight,iNewNode,segNode[y]);
+        // trim x and y
+        if (segRight[x]==dRight){
+          int next = segNext[x];
+          freeSegment(x);
+          x = next;
+        }else{
+          segLeft[x] = dRight;
+        }
+        if (segRight[y]==dRight){
+          int next = segNext[y];
+          freeSegment(y);
+          y = next;
+        }else{
+          segLeft[y] = dRight;
+        }
+      }
+    }
+    if (alpha>=0){
+      if (z<0){
+        addLineage(alpha,pop);
+      }else{
+        segNext[z] = alpha;
+      }
+      segPrev[alpha] = z;
+      segPop[alpha] = pop;
+      setSegmentMass(alpha);
+      z = alpha;
+    }
+  }
+}
+
+void HudsonBuilder::moveLineage(int head,int pop){
+  removeLineage(head);
+  for (int seg=head;seg>=0;seg=segNext[seg]){
+    segPop[seg] = pop;
+  }
+  addLineage(head,pop);
+}
+
+void HudsonBuilder::migrationEvent(){
+  unsigned int iTotalPops = pPopList.size();
+  double dTotal = 0.;
+  for (unsigned int i=0;i<iTotalPops;++i){
+    dTotal += popLineages[i].size()*dMigrationMatrix[i][i];
+  }
+  double h = pRandNumGenerator->unifRV()*dTotal;
+  unsigned int source = 0;
+  for (;source<iTotalPops-1;++source){
+    h -= popLineages[source].size()*dMigrationMatrix[source][source];
+    if (h<0.) break;
+  }
+  int head = sampleLineage(source);
+  h = pRandNumGenerator->unifRV()*dMigrationMatrix[source][source];
+  unsigned int dest = 0;
+  for (unsigned int i=0;i<iTotalPops;++i){
+    if (i==source) continue;
+    dest = i;
+    h -= dMigrationMatrix[source][i];
+    if (h<0.) break;
+  }
+  moveLineage(head,dest);
+}
+
+void HudsonBuilder::applyEvent(EventPtr & event){
+  short unsigned int iTotalPops = pPopList.size();
+  Event::EventType eventType = event->getType();
+  if (eventType==Event::GLOBAL_POPSIZE){
+    GenericEvent * pGenericEvent = static_cast<GenericEvent *>(event.get());
+    for (short unsigned int i=0;i<iTotalPops;++i){
+      pPopList[i].setPopSize(pGenericEvent->getParamValue());
+      pPopList[i].setGrowthAlpha(0);
+    }
+  }else if (eventType==Event::GLOBAL_POPGROWTH){
+    GenericEvent * pGenericEvent = static_cast<GenericEvent *>(event.get());
+    for (short unsigned int i=0;i<iTotalPops;++i){
+      Population & pop = pPopList[i];
+      pop.setPopSize(pop.getPopSize()*exp(-pop.getGrowthAlpha()*
+        (dTime-pop.getLastTime())));
+      pop.setGrowthAlpha(pGenericEvent->getParamValue());
+      pop.setLastTime(dTime);
+    }
+  }else if (eventType==Event::POPSIZE){
+    PopSizeChangeEvent * pSizeEvent =
+      static_cast<PopSizeChangeEvent *>(event.get());
+    short int pop = pSizeEvent->getPopulationIndex();
+    pPopList[pop].setPopSize(pSizeEvent->getPopChangeParam());
+    pPopList[pop].setGrowthAlpha(0);
+  }else if (eventType==Event::GROWTH){
+    PopSizeChangeEvent * pGrowthEvent =
+      static_cast<PopSizeChangeEvent *>(event.get());
+    Population & pop = pPopList[pGrowthEvent->getPopulationIndex()];
+    pop.setPopSize(pop.getPopSize()*exp(-pop.getGrowthAlpha()*
+      (dTime-pop.getLastTime())));
+    pop.setGrowthAlpha(pGrowthEvent->getPopChangeParam());
+    pop.setLastTime(dTime);
+  }else if (eventType==Event::MIGRATION_MATRIX_RATE){
+    MigrationRateMatrixEvent * pMatrixEvent =
+      static_cast<MigrationRateMatrixEvent *>(event.get());
+    dMigrationMatrix = pMatrixEvent->getMigrationMatrix();
+    if (dMigrationMatrix.size()!=pPopList.size()){
+      throw "Invalid migration matrix";
+    }
+  }else if (eventType==Event::MIGRATION_RATE){
+    MigrationRateEvent * pRateEvent =
+      static_cast<MigrationRateEvent *>(event.get());
+    short int iSourcePop = pRateEvent->getSourcePop();
+    short int iDestPop = pRateEvent->getDestPop();
+    dMigrationMatrix[iSourcePop][iSourcePop] +=
+      pRateEvent->getRate()-dMigrationMatrix[iSourcePop][iDestPop];
+    dMigrationMatrix[iSourcePop][iDestPop] = pRateEvent->getRate();
+  }else if (eventType==Event::GLOBAL_MIGRATIONRATE){
+    GenericEvent * pGenericEvent = static_cast<GenericEvent *>(event.get());
+    for (short unsigned int i=0;i<iTotalPops;++i){
+      for (short unsigned int j=0;j<iTotalPops;++j){
+        dMigrationMatrix[i][j] = pGenericEvent->getParamValue()/(iTotalPops-1);
+      }
+      dMigrationMatrix[i][i] = pGenericEvent->getParamValue();
+    }
+  }else if (eventType==Event::POPJOIN){
+    PopJoinEvent * pJoinEvent = static_cast<PopJoinEvent *>(event.get());
+    short int iSourcePop = pJoinEvent->getSourcePop();
+    short int iDestPop = pJoinEvent->getDestPop();
+    if (iSourcePop>=iTotalPops || iDestPop>=iTotalPops){
+      throw "Invalid population in join event";
+    }
+    while (!popLineages[iSourcePop].empty()){
+      moveLineage(popLineages[iSourcePop].back(),iDestPop);
+    }
+    // the source population is dead and doesn't accept migrants
+    for (int j=0;j<iTotalPops;++j){
+      if (j==iSourcePop){
+        for (int k=0;k<iTotalPops;++k){
+          dMigrationMatrix[j][k] = 0.;
+        }
+      }else{
+        dMigrationMatrix[j][j] -= dMigrationMatrix[j][iSourcePop];
+        dMigrationMatrix[j][iSourcePop] = 0.;
+      }
+    }
+  }else if (eventType==Event::POPSPLIT){
+    PopSizeChangeEvent * pSplitEvent =
+      static_cast<PopSizeChangeEvent *>(event.get());
+    short int iSourcePop = pSplitEvent->getPopulationIndex();
+    short int iDestPop = iTotalPops;
+    double dProportion = pSplitEvent->getPopChangeParam();
+    Population newPop;
+    pPopList.push_back(newPop);
+    popLineages.push_back(vector<int>());
+    for (int j=0;j<iTotalPops;++j){
+      dMigrationMatrix[j].push_back(pConfig->dGlobalMigration);
+    }
+    dMigrationMatrix.push_back(vector<double>(iTotalPops+1,
+                                              pConfig->dGlobalMigration));
+    vector<int> toMove;
+    for (unsigned int i=0;i<popLineages[iSourcePop].size();++i){
+      if (pRandNumGenerator->unifRV()<dProportion){
+        toMove.push_back(popLineages[iSourcePop][i]);
+      }
+    }
+    for (unsigned int i=0;i<toMove.size();++i){
+      moveLineage(toMove[i],iDestPop);
+    }
+  }else{
+    Rcpp::Rcerr<<"Found an event of type "<<event->getType()<<endl;
+    throw "Event is not supported by the Hudson simulator";
+  }
+}
+
+void HudsonBuilder::addMutations(){
+  double dTheta = pConfig->dTheta;
+  if (dTheta<=0.) return;
+  vector<pair<double,int> > sites;
+  unsigned int nEdges = pTreeSeq->edgeLeft.size();
+  for (unsigned int e=0;e<nEdges;++e){
+    int iChild = pTreeSeq->edgeChild[e];
+    double dBranch = pTreeSeq->nodeTime[pTreeSeq->edgeParent[e]]-
+      pTreeSeq->nodeTime[iChild];
+    double dPos = pTreeSeq->edgeLeft[e];
+    while (true){
+      dPos += pRandNumGenerator->expRV(dBranch*dTheta);
+      if (dPos>=pTreeSeq->edgeRight[e]) break;
+      sites.push_back(make_pair(dPos,iChild));
+    }
+  }
+  sort(sites.begin(),sites.end());
+  for (unsigned int i=0;i<sites.size();++i){
+    pTreeSeq->addSite(sites[i].first,sites[i].second);
+  }
+}
+
+void HudsonBuilder::build(){
+  short unsigned int iTotalPops = pPopList.size();
+  double dRho = pConfig->dRecombRateRAcrossSites;
+  // sample nodes occupy the first rows of the node table
+  popLineages.assign(iTotalPops,vector<int>());
+  pTreeSeq->iSampleSize = pConfig->iSampleSize;
+  int iSample = 0;
+  for (short unsigned int pop=0;pop<iTotalPops;++pop){
+    for (int i=0;i<pPopList[pop].getChrSampled();++i){
+      int node = pTreeSeq->addNode(0.);
+      int head = allocSegment(0.,1.,node,pop);
+      setSegmentMass(head);
+      addLineage(head,pop);
+      ++iSample;
+    }
+  }
+  overlapCounts.clear();
+  overlapCounts[0.] = iSample;
+  overlapCounts[1.] = -1;
+
+  EventPtrList::iterator eventIt = pConfig->pEventList->begin();
+  while (iTotalLineages>0){
+    iTotalPops = pPopList.size();
+    bool bIsEvent = false;
+    double dWaitTime = 0.;
+    int iEventPop = -1;
+    enum {COAL_EVENT,XOVER_EVENT,MIGRATION_EVENT} iEventType = COAL_EVENT;
+    // coalescence in each population
+    for (short unsigned int pop=0;pop<iTotalPops;++pop){
+      double n = popLineages[pop].size();
+      double dCoalRate = n*(n-1.);
+      if (dCoalRate<=0. || pPopList[pop].getPopSize()<=0.) continue;
+      double dProposedWaitTime;
+      if (pPopList[pop].getGrowthAlpha()==0.){
+        dProposedWaitTime = pRandNumGenerator->expRV(
+          dCoalRate/pPopList[pop].getPopSize());
+      }else{
+        double dCoalRateAlpha = 1.-pPopList[pop].getGrowthAlpha()*
+          pPopList[pop].getPopSize()*
+          exp(-pPopList[pop].getGrowthAlpha()*
+          (dTime-pPopList[pop].getLastTime()))*
+          log(pRandNumGenerator->unifRV())/dCoalRate;
+        // no coalescence is possible when the population shrinks fast
+        if (dCoalRateAlpha<=0.) continue;
+        dProposedWaitTime = log(dCoalRateAlpha)/
+          pPopList[pop].getGrowthAlpha();
+      }
+      if (!bIsEvent || dProposedWaitTime<dWaitTime){
+        dWaitTime = dProposedWaitTime;
+        iEventType = COAL_EVENT;
+        iEventPop = pop;
+        bIsEvent = true;
+      }
+    }
+    // recombination anywhere in the ancestral material
+    double dXoverRate = dRho*links.getTotal();
+    if (dXoverRate>0.){
+      double dProposedWaitTime = pRandNumGenerator->expRV(dXoverRate);
+      if (!bIsEvent || dProposedWaitTime<dWaitTime){
+        dWaitTime = dProposedWaitTime;
+        iEventType = XOVER_EVENT;
+        bIsEvent = true;
+      }
+    }
+    // migration
+    double dMigration = 0.;
+    for (short unsigned int pop=0;pop<iTotalPops;++pop){
+      dMigration += popLineages[pop].size()*dMigrationMatrix[pop][pop];
+    }
+    if (dMigration>0.){
+      double dProposedWaitTime = pRandNumGenerator->expRV(dMigration);
+      if (!bIsEvent || dProposedWaitTime<dWaitTime){
+        dWaitTime = dProposedWaitTime;
+        iEventType = MIGRATION_EVENT;
+        bIsEvent = true;
+      }
+    }
+    // demographic events take precedence
+    if (eventIt!=pConfig->pEventList->end() &&
+        (!bIsEvent || dTime+dWaitTime>=(*eventIt)->getTime())){
+      dTime = (*eventIt)->getTime();
+      applyEvent(*eventIt);
+      ++eventIt;
+      continue;
+    }
+    if (!bIsEvent){
+      throw "Infinite coalescent time. No migration.";
+    }
+    dTime += dWaitTime;
+    switch(iEventType){
+    case COAL_EVENT:
+      coalescenceEvent(iEventPop);
+      break;
+    case XOVER_EVENT:
+      recombinationEvent();
+      break;
+    case MIGRATION_EVENT:
+      migrationEvent();
+      break;
+    }
+  }
+  addMutations();
+}
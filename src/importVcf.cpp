@@ -0,0 +1,347 @@
+#include "alphasimr.h"
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <stdint.h>
+
+// A site parsed from one line of a VCF. The alleles of all haplotypes
+// are packed into bits in sample order.
+struct VcfSite{
+  std::string chr;
+  std::string name;
+  double pos;
+  std::vector<unsigned char> bits;
+  // 0 for a valid site, 1 for a skipped multi-allelic site, otherwise
+  // a parse error
+  int status;
+};
+
+// Returns the end of the tab separated field starting at begin
+inline const char* fieldEnd(const char* begin, const char* end){
+  const char* tab = static_cast<const char*>(
+    std::memchr(begin, '\t', end-begin));
+  return (tab==NULL) ? end : tab;
+}
+
+// Parses a VCF data line. Status codes above 1 are the errors reported
+// by vcfError.
+void parseVcfLine(const std::string& line, arma::uword nSamples,
+                  arma::uword ploidy, VcfSite& site){
+  const char* p = line.data();
+  const char* end = p + line.size();
+  const char* field[9];
+  const char* fEnd[9];
+  for(int i=0; i<9; ++i){
+    if(p>=end){
+      site.status = 2;
+      return;
+    }
+    field[i] = p;
+    fEnd[i] = fieldEnd(p, end);
+    p = fEnd[i] + 1;
+  }
+  site.chr.assign(field[0], fEnd[0]);
+  site.pos = std::strtod(std::string(field[1], fEnd[1]).c_str(), NULL);
+  if((fEnd[2]-field[2]==1) && (*field[2]=='.')){
+    site.name = site.chr + "_" + std::string(field[1], fEnd[1]);
+  }else{
+    site.name.assign(field[2], fEnd[2]);
+  }
+  if(std::memchr(field[4], ',', fEnd[4]-field[4]) != NULL){
+    site.status = 1;
+    return;
+  }
+  if((fEnd[8]-field[8]<2) || (std::strncmp(field[8], "GT", 2)!=0)){
+    site.status = 3;
+    return;
+  }
+  site.bits.assign((nSamples*ploidy+7)/8, 0);
+  arma::uword hap = 0;
+  for(arma::uword i=0; i<nSamples; ++i){
+    if(p>end){
+      site.status = 2;
+      return;
+    }
+    // Alleles are read up to the end of the GT subfield
+    arma::uword nAllele = 0;
+    bool newAllele = true;
+    for(; (p<end) && (*p!='\t') && (*p!=':'); ++p){
+      if((*p=='|') || (*p=='/')){
+        newAllele = true;
+      }else if(*p=='.'){
+        site.status = 4;
+        return;
+      }else if(newAllele){
+        if(nAllele==ploidy){
+          site.status = 5;
+          return;
+        }
+        newAllele = false;
+        ++nAllele;
+        ++hap;
+      }
+      if((*p>'0') && (*p<='9')){
+        site.bits[(hap-1)/8] |= static_cast<unsigned char>(1u<<((hap-1)%8));
+      }
+    }
+    if(nAllele!=ploidy){
+      site.status = 5;
+      return;
+    }
+    p = fieldEnd(p, end) + 1;
+  }
+  site.status = 0;
+}
+
+void vcfError(int status, arma::uword lineNumber){
+  std::string line = std::to_string(lineNumber);
+  switch(status){
+  case 2:
+    Rcpp::stop("Too few fields on line "+line);
+  case 3:
+    Rcpp::stop("FORMAT doesn't start with GT on line "+line);
+  case 4:
+    Rcpp::stop("Missing genotype on line "+line);
+  default:
+    Rcpp::stop("Number of alleles doesn't match ploidy on line "+line);
+  }
+}
+
+// Transposes sites stored as rows of packed haplotypes to a geno
+// array, 8 sites by 8 haplotypes at a time
+void transposeSites(const std::vector<const unsigned char*>& rows,
+                    arma::uword nHap, unsigned char* geno,
+                    int nThreads){
+  arma::uword nLoci = rows.size();
+  arma::uword nBins = (nLoci+7)/8;
+  arma::uword nBytes = (nHap+7)/8;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword j=0; j<nBins; ++j){
+    arma::uword nSite = std::min<arma::uword>(8, nLoci-8*j);
+    for(arma::uword b=0; b<nBytes; ++b){
+      uint64_t x = 0;
+      for(arma::uword k=0; k<nSite; ++k){
+        x |= static_cast<uint64_t>(rows[8*j+k][b]) << (8*k);
+      }
+      x = transposeBits(x);
+      arma::uword nH = std::min<arma::uword>(8, nHap-8*b);
+      for(arma::uword h=0; h<nH; ++h){
+        geno[j + nBins*(8*b+h)] = static_cast<unsigned char>(x >> (8*h));
+      }
+    }
+  }
+}
+
+// Reads phased genotypes from a VCF in blocks of nLines lines. Lines
+// in a block are parsed in parallel and each site is stored as packed
+// bits, so memory use is close to the size of the final geno arrays.
+// If genMap is empty, sites are placed on chromosomes by CHROM and
+// ordered by POS. Otherwise sites are matched to the names in genMap.
+// [[Rcpp::export]]
+Rcpp::List readVcf(Rcpp::String filePath, Rcpp::List genMap,
+                   arma::uword ploidy, arma::uword nLines,
+                   int nThreads, bool verbose){
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  std::ifstream file(filePath.get_cstring(), std::ios::binary);
+  if(!file){
+    Rcpp::stop("Unable to open "+std::string(filePath.get_cstring()));
+  }
+  std::string line;
+  arma::uword lineNumber = 0;
+  double nChar = 0;
+
+  // Skip meta-information and read sample names from the header
+  std::vector<std::string> id;
+  while(std::getline(file, line)){
+    ++lineNumber;
+    nChar += line.size() + 1;
+    if(line.compare(0, 2, "##")==0){
+      continue;
+    }
+    if(line.compare(0, 6, "#CHROM")!=0){
+      Rcpp::stop("Header line starting with #CHROM not found");
+    }
+    if(!line.empty() && (line[line.size()-1]=='\r')){
+      line.erase(line.size()-1);
+    }
+    const char* p = line.data();
+    const char* end = p + line.size();
+    for(arma::uword i=0; p<=end; ++i){
+      const char* fEnd = fieldEnd(p, end);
+      if(i>=9){
+        id.push_back(std::string(p, fEnd));
+      }
+      p = fEnd + 1;
+    }
+    break;
+  }
+  if(id.empty()){
+    Rcpp::stop("No samples found in VCF");
+  }
+  arma::uword nSamples = id.size();
+  arma::uword nHap = nSamples*ploidy;
+  arma::uword nBytes = (nHap+7)/8;
+
+  // Sites are kept per chromosome as rows of packed haplotypes
+  bool useMap = genMap.size()>0;
+  std::vector<std::string> chrName;
+  std::unordered_map<std::string, arma::uword> chrIndex;
+  std::vector<std::vector<unsigned char> > chrBits;
+  std::vector<std::vector<double> > chrPos;
+  std::vector<std::vector<std::string> > chrSiteName;
+  // With a genetic map, each name gives a chromosome and locus
+  std::unordered_map<std::string, std::pair<arma::uword, arma::uword> > mapIndex;
+  std::vector<std::vector<bool> > found;
+  if(useMap){
+    Rcpp::CharacterVector mapChr = genMap.names();
+    for(arma::uword chr=0; chr<arma::uword(genMap.size()); ++chr){
+      Rcpp::NumericVector chrMap = genMap[chr];
+      Rcpp::CharacterVector siteName = chrMap.names();
+      chrName.push_back(Rcpp::as<std::string>(mapChr[chr]));
+      chrBits.push_back(std::vector<unsigned char>(chrMap.size()*nBytes));
+      chrPos.push_back(Rcpp::as<std::vector<double> >(chrMap));
+      chrSiteName.push_back(Rcpp::as<std::vector<std::string> >(siteName));
+      found.push_back(std::vector<bool>(chrMap.size(), false));
+      for(arma::uword i=0; i<arma::uword(chrMap.size()); ++i){
+        mapIndex[chrSiteName[chr][i]] = std::make_pair(chr, i);
+      }
+    }
+  }
+
+  // Read, parse and store sites one block of lines at a time
+  std::vector<std::string> lines(nLines);
+  std::vector<VcfSite> sites(nLines);
+  arma::uword nSites = 0, nSkipped = 0;
+  while(file){
+    arma::uword n = 0;
+    arma::uword firstLine = lineNumber + 1;
+    while((n<nLines) && std::getline(file, lines[n])){
+      ++lineNumber;
+      nChar += lines[n].size() + 1;
+      if(!lines[n].empty() && (lines[n][lines[n].size()-1]=='\r')){
+        lines[n].erase(lines[n].size()-1);
+      }
+      if(!lines[n].empty()){
+        ++n;
+      }
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for(arma::uword i=0; i<n; ++i){
+      parseVcfLine(lines[i], nSamples, ploidy, sites[i]);
+    }
+    for(arma::uword i=0; i<n; ++i){
+      VcfSite& site = sites[i];
+      if(site.status>1){
+        // Blank lines are dropped, so the line number is approximate
+        vcfError(site.status, firstLine+i);
+      }
+      if(site.status==1){
+        ++nSkipped;
+        continue;
+      }
+      if(useMap){
+        std::unordered_map<std::string,
+                           std::pair<arma::uword, arma::uword> >::iterator
+          it = mapIndex.find(site.name);
+        if(it==mapIndex.end()){
+          ++nSkipped;
+          continue;
+        }
+        arma::uword chr = it->second.first;
+        arma::uword locus = it->second.second;
+        std::memcpy(&chrBits[chr][locus*nBytes], site.bits.data(), nBytes);
+        found[chr][locus] = true;
+      }else{
+        std::unordered_map<std::string, arma::uword>::iterator
+          it = chrIndex.find(site.chr);
+        arma::uword chr;
+        if(it==chrIndex.end()){
+          chr = chrName.size();
+          chrIndex[site.chr] = chr;
+          chrName.push_back(site.chr);
+          chrBits.push_back(std::vector<unsigned char>());
+          chrPos.push_back(std::vector<double>());
+          chrSiteName.push_back(std::vector<std::string>());
+        }else{
+          chr = it->second;
+        }
+        chrBits[chr].insert(chrBits[chr].end(), site.bits.begin(),
+                            site.bits.end());
+        chrPos[chr].push_back(site.pos);
+        chrSiteName[chr].push_back(site.name);
+      }
+      ++nSites;
+    }
+    Rcpp::checkUserInterrupt();
+  }
+  file.close();
+
+  // Order sites and pack them into geno arrays
+  arma::uword nChr = chrName.size();
+  Rcpp::List geno, outMap;
+  Rcpp::CharacterVector outChr;
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    std::vector<arma::uword> order;
+    if(useMap){
+      for(arma::uword i=0; i<found[chr].size(); ++i){
+        if(found[chr][i]){
+          order.push_back(i);
+        }
+      }
+    }else{
+      order.resize(chrPos[chr].size());
+      for(arma::uword i=0; i<order.size(); ++i){
+        order[i] = i;
+      }
+      const std::vector<double>& pos = chrPos[chr];
+      std::stable_sort(order.begin(), order.end(),
+                       [&pos](arma::uword a, arma::uword b){
+                         return pos[a]<pos[b];
+                       });
+    }
+    if(order.empty()){
+      continue;
+    }
+    std::vector<const unsigned char*> rows(order.size());
+    Rcpp::NumericVector sitePos(order.size());
+    Rcpp::CharacterVector siteName(order.size());
+    for(arma::uword i=0; i<order.size(); ++i){
+      rows[i] = &chrBits[chr][order[i]*nBytes];
+      sitePos[i] = chrPos[chr][order[i]];
+      siteName[i] = chrSiteName[chr][order[i]];
+    }
+    sitePos.names() = siteName;
+    arma::uword nBins = (order.size()+7)/8;
+    Rcpp::RawVector chrGeno(nBins*nHap);
+    chrGeno.attr("dim") = Rcpp::Dimension(nBins, ploidy, nSamples);
+    transposeSites(rows, nHap, RAW(chrGeno), nThreads);
+    // Release the rows of this chromosome
+    std::vector<unsigned char>().swap(chrBits[chr]);
+    geno.push_back(chrGeno);
+    outMap.push_back(sitePos);
+    outChr.push_back(chrName[chr]);
+  }
+  outMap.names() = outChr;
+
+  if(verbose){
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now()-start).count();
+    Rcpp::Rcout<<"Read "<<nSites<<" sites for "<<nSamples
+               <<" samples in "<<seconds<<" seconds ("
+               <<nChar/1e6/std::max(seconds, 1e-9)<<" MB/s)"<<std::endl;
+    if(nSkipped>0){
+      Rcpp::Rcout<<"Skipped "<<nSkipped
+                 <<" multi-allelic or unmapped sites"<<std::endl;
+    }
+  }
+
+  return Rcpp::List::create(Rcpp::Named("geno")=geno,
+                            Rcpp::Named("genMap")=outMap,
+                            Rcpp::Named("id")=id);
+}
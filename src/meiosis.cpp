@@ -992,9 +992,9 @@ void quadrivalent(const arma::Col<unsigned char>& chr1,
 }
 
 // Makes crosses between diploid individuals.
-// motherGeno: female genotypes
+// motherGenoList: female genotypes, i.e. the geno slot
 // mother: female parents
-// fatherGeno: male genotypes
+// fatherGenoList: male genotypes, i.e. the geno slot
 // father: male parents
 // femaleMap: chromosome genetic maps
 // maleMap: chromosome genetic maps
@@ -1007,9 +1007,9 @@ void quadrivalent(const arma::Col<unsigned char>& chr1,
 // nThreads: number of threads for parallel computing
 // [[Rcpp::export]]
 Rcpp::List cross(
-    const arma::field<arma::Cube<unsigned char> >& motherGeno, 
+    SEXP motherGenoList, 
     arma::uvec mother,
-    const arma::field<arma::Cube<unsigned char> >& fatherGeno, 
+    SEXP fatherGenoList, 
     arma::uvec father,
     const arma::field<arma::vec>& femaleMap,
     const arma::field<arma::vec>& maleMap,
@@ -1024,8 +1024,11 @@ Rcpp::List cross(
     int nThreads){
   mother -= 1; // R to C++
   father -= 1; // R to C++
+  // Parent haplotypes are read in place, see GenoView
+  GenoView motherGeno(motherGenoList);
+  GenoView fatherGeno(fatherGenoList);
   arma::uword ploidy = (motherPloidy+fatherPloidy)/2;
-  arma::uword nChr = motherGeno.n_elem;
+  arma::uword nChr = motherGeno.nChr;
   arma::uword nInd = mother.n_elem;
   //Output data
   arma::field<arma::Cube<unsigned char> > geno(nChr);
@@ -1050,7 +1053,7 @@ Rcpp::List cross(
     for(arma::uword i=0; i<fatherPloidy; ++i)
       xf(i) = i;
     arma::uword progenyChr;
-    arma::uword nBins = motherGeno(chr).n_rows;
+    arma::uword nBins = motherGeno.nBins[chr];
     arma::Cube<unsigned char> tmpGeno(nBins,ploidy,nInd);
     arma::Col<unsigned char> gamete1(nBins), gamete2(nBins);
     
@@ -1065,8 +1068,8 @@ Rcpp::List cross(
           u.randu();
           if(u(0)>quadProb){
             //Bivalent 1
-            bivalent(motherGeno(chr).slice(mother(ind)).col(xm(x)),
-                     motherGeno(chr).slice(mother(ind)).col(xm(x+1)),
+            bivalent(motherGeno.haploCol(chr,xm(x),mother(ind)),
+                     motherGeno.haploCol(chr,xm(x+1),mother(ind)),
                      femaleMap(chr),
                      v,
                      p,
@@ -1082,8 +1085,8 @@ Rcpp::List cross(
             ++progenyChr;
             
             //Bivalent 2
-            bivalent(motherGeno(chr).slice(mother(ind)).col(xm(x+2)),
-                     motherGeno(chr).slice(mother(ind)).col(xm(x+3)),
+            bivalent(motherGeno.haploCol(chr,xm(x+2),mother(ind)),
+                     motherGeno.haploCol(chr,xm(x+3),mother(ind)),
                      femaleMap(chr),
                      v,
                      p,
@@ -1099,10 +1102,10 @@ Rcpp::List cross(
             ++progenyChr;
           }else{
             //Quadrivalent
-            quadrivalent(motherGeno(chr).slice(mother(ind)).col(xm(x)),
-                         motherGeno(chr).slice(mother(ind)).col(xm(x+1)),
-                         motherGeno(chr).slice(mother(ind)).col(xm(x+2)),
-                         motherGeno(chr).slice(mother(ind)).col(xm(x+3)),
+            quadrivalent(motherGeno.haploCol(chr,xm(x),mother(ind)),
+                         motherGeno.haploCol(chr,xm(x+1),mother(ind)),
+                         motherGeno.haploCol(chr,xm(x+2),mother(ind)),
+                         motherGeno.haploCol(chr,xm(x+3),mother(ind)),
                          femaleMap(chr),
                          motherCentromere(chr),
                          v,
@@ -1127,8 +1130,8 @@ Rcpp::List cross(
           }
         }else{
           //Bivalent
-          bivalent(motherGeno(chr).slice(mother(ind)).col(xm(x)),
-                   motherGeno(chr).slice(mother(ind)).col(xm(x+1)),
+          bivalent(motherGeno.haploCol(chr,xm(x),mother(ind)),
+                   motherGeno.haploCol(chr,xm(x+1),mother(ind)),
                    femaleMap(chr),
                    v,
                    p,
@@ -1152,8 +1155,8 @@ Rcpp::List cross(
           u.randu();
           if(u(0)>quadProb){
             //Bivalent 1
-            bivalent(fatherGeno(chr).slice(father(ind)).col(xf(x)),
-                     fatherGeno(chr).slice(father(ind)).col(xf(x+1)),
+            bivalent(fatherGeno.haploCol(chr,xf(x),father(ind)),
+                     fatherGeno.haploCol(chr,xf(x+1),father(ind)),
                      maleMap(chr),
                      v,
                      p,
@@ -1169,8 +1172,8 @@ Rcpp::List cross(
             ++progenyChr;
             
             //Bivalent 2
-            bivalent(fatherGeno(chr).slice(father(ind)).col(xf(x+2)),
-                     fatherGeno(chr).slice(father(ind)).col(xf(x+3)),
+            bivalent(fatherGeno.haploCol(chr,xf(x+2),father(ind)),
+                     fatherGeno.haploCol(chr,xf(x+3),father(ind)),
                      maleMap(chr),
                      v,
                      p,
@@ -1186,10 +1189,10 @@ Rcpp::List cross(
             ++progenyChr;
           }else{
             //Quadrivalent
-            quadrivalent(fatherGeno(chr).slice(father(ind)).col(xf(x)),
-                         fatherGeno(chr).slice(father(ind)).col(xf(x+1)),
-                         fatherGeno(chr).slice(father(ind)).col(xf(x+2)),
-                         fatherGeno(chr).slice(father(ind)).col(xf(x+3)),
+            quadrivalent(fatherGeno.haploCol(chr,xf(x),father(ind)),
+                         fatherGeno.haploCol(chr,xf(x+1),father(ind)),
+                         fatherGeno.haploCol(chr,xf(x+2),father(ind)),
+                         fatherGeno.haploCol(chr,xf(x+3),father(ind)),
                          maleMap(chr),
                          fatherCentromere(chr),
                          v,
@@ -1214,8 +1217,8 @@ Rcpp::List cross(
           }
         }else{
           //Bivalent
-          bivalent(fatherGeno(chr).slice(father(ind)).col(xf(x)),
-                   fatherGeno(chr).slice(father(ind)).col(xf(x+1)),
+          bivalent(fatherGeno.haploCol(chr,xf(x),father(ind)),
+                   fatherGeno.haploCol(chr,xf(x+1),father(ind)),
                    maleMap(chr),
                    v,
                    p,
@@ -1241,16 +1244,176 @@ Rcpp::List cross(
   return Rcpp::List::create(Rcpp::Named("geno")=geno);
 }
 
+// Forms a gamete from a parent using bivalent pairing only
+// parent: genotypes of the parent's chromosome
+// genMap: chromosome genetic map
+// v: interference parameter for gamma model
+// p: proportion of non-interfering crossovers
+// output: genotypes of the progeny, gametes are written starting 
+//   at column firstCol
+void bivalentGamete(const arma::Mat<unsigned char>& parent,
+                    const arma::vec& genMap,
+                    double v,
+                    double p,
+                    arma::Mat<unsigned char>& output,
+                    arma::uword firstCol){
+  arma::uword ploidy = parent.n_cols;
+  arma::uvec x(ploidy);
+  for(arma::uword i=0; i<ploidy; ++i)
+    x(i) = i;
+  x = shuffle(x);
+  arma::Col<unsigned char> gamete(parent.n_rows);
+  arma::Mat<int> hist;
+  for(arma::uword i=0; i<ploidy; i+=2){
+    bivalent(parent.col(x(i)), parent.col(x(i+1)), genMap, 
+             v, p, gamete, hist);
+    output.col(firstCol+i/2) = gamete;
+  }
+}
+
+// Forward-time Wright-Fisher simulation for burn-in of founders. 
+// Each generation has Ne individuals whose parents are sampled with 
+// replacement from the selected individuals of the previous generation.
+// Two sets of genotypes are used, swapping between generations.
+// geno: founder genotypes
+// genMap: chromosome genetic maps, starting at zero
+// Ne: number of individuals in each generation
+// nGen: number of generations
+// mutRate: per site rate of allele changes in a gamete
+// addEff: additive effects for all sites, used for selection
+// selProp: proportion of individuals selected as parents
+// varE: error variance added to genetic values for selection
+// v: interference parameter for gamma model
+// p: proportion of non-interfering crossovers
+// nThreads: number of threads for parallel computing
+// [[Rcpp::export]]
+Rcpp::List forwardSim(
+    arma::field<arma::Cube<unsigned char> > geno, 
+    const arma::field<arma::vec>& genMap,
+    arma::uword Ne,
+    arma::uword nGen,
+    double mutRate,
+    const arma::field<arma::vec>& addEff,
+    double selProp,
+    double varE,
+    double v,
+    double p,
+    int nThreads){
+  arma::uword nChr = geno.n_elem;
+  arma::uword ploidy = geno(0).n_cols;
+  if((ploidy%2)!=0){
+    Rcpp::stop("forward simulation requires an even ploidy level");
+  }
+  
+  // Sites with non-zero effects
+  arma::field<arma::uvec> effLoci(nChr);
+  arma::field<arma::vec> effSize(nChr);
+  arma::uword nEffLoci = 0;
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    effLoci(chr) = find(addEff(chr)!=0);
+    effSize(chr) = addEff(chr)(effLoci(chr));
+    nEffLoci += effLoci(chr).n_elem;
+  }
+  bool selection = (nEffLoci>0) && (selProp<1);
+  
+  int chrThreads = nThreads;
+  if(nChr < static_cast<arma::uword>(chrThreads) ){
+    chrThreads = nChr;
+  }
+  arma::field<arma::Cube<unsigned char> > nextGeno(nChr);
+  for(arma::uword gen=0; gen<nGen; ++gen){
+    Rcpp::checkUserInterrupt();
+    arma::uword nInd = geno(0).n_slices;
+    
+    // Candidate parents
+    arma::uvec cand;
+    if(selection){
+      arma::vec gv(nInd, arma::fill::zeros);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+      for(arma::uword ind=0; ind<nInd; ++ind){
+        for(arma::uword chr=0; chr<nChr; ++chr){
+          const unsigned char* indGeno = geno(chr).slice_memptr(ind);
+          arma::uword nBins = geno(chr).n_rows;
+          for(arma::uword i=0; i<effLoci(chr).n_elem; ++i){
+            arma::uword locus = effLoci(chr)(i);
+            arma::uword dose = 0;
+            for(arma::uword k=0; k<ploidy; ++k){
+              dose += (indGeno[locus/8+k*nBins]>>(locus%8))&1;
+            }
+            gv(ind) += effSize(chr)(i)*double(dose);
+          }
+        }
+      }
+      if(varE>0){
+        gv += arma::randn<arma::vec>(nInd)*std::sqrt(varE);
+      }
+      arma::uword nSel = std::max(arma::uword(1), 
+                                  arma::uword(selProp*nInd+0.5));
+      cand = sort_index(gv, "descend");
+      cand = cand.head(nSel);
+    }else{
+      cand = arma::regspace<arma::uvec>(0, nInd-1);
+    }
+    
+    // Sample parents
+    arma::vec u(Ne, arma::fill::randu);
+    arma::uvec mother = cand(arma::conv_to<arma::uvec>::from(
+      floor(u*double(cand.n_elem))));
+    u.randu();
+    arma::uvec father = cand(arma::conv_to<arma::uvec>::from(
+      floor(u*double(cand.n_elem))));
+    
+    //Loop through chromosomes
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(chrThreads)
+#endif
+    for(arma::uword chr=0; chr<nChr; ++chr){
+      arma::uword nBins = geno(chr).n_rows;
+      arma::uword nLoci = genMap(chr).n_elem;
+      nextGeno(chr).set_size(nBins, ploidy, Ne);
+      arma::vec w(1);
+      for(arma::uword ind=0; ind<Ne; ++ind){
+        bivalentGamete(geno(chr).slice(mother(ind)), genMap(chr), v, p,
+                       nextGeno(chr).slice(ind), 0);
+        bivalentGamete(geno(chr).slice(father(ind)), genMap(chr), v, p,
+                       nextGeno(chr).slice(ind), ploidy/2);
+        // Mutations occur as a Poisson process along each gamete
+        if(mutRate>0){
+          for(arma::uword k=0; k<ploidy; ++k){
+            unsigned char* hap = nextGeno(chr).slice_colptr(ind, k);
+            w.randu();
+            double pos = -log(w(0))/mutRate;
+            while(pos<double(nLoci)){
+              arma::uword locus = arma::uword(pos);
+              hap[locus/8] ^= (1<<(locus%8));
+              w.randu();
+              pos += -log(w(0))/mutRate;
+            }
+          }
+        }
+      }
+      std::swap(geno(chr), nextGeno(chr));
+    } //End chromosome loop
+  } //End generation loop
+  return Rcpp::List::create(Rcpp::Named("geno")=geno);
+}
+
 // Creates DH lines from diploid individuals
+// Both haplotypes of a DH line are the same gamete, so each gamete is 
+// stored once in a pooled array
 // [[Rcpp::export]]
 Rcpp::List createDH2(
-    const arma::field<arma::Cube<unsigned char> >& geno, 
+    SEXP genoList, 
     arma::uword nDH, const arma::field<arma::vec>& genMap, 
     double v, double p, bool trackRec, int nThreads){
-  arma::uword nChr = geno.n_elem;
-  arma::uword nInd = geno(0).n_slices;
+  // Parent haplotypes are read in place, see GenoView
+  GenoView geno(genoList);
+  arma::uword nChr = geno.nChr;
+  arma::uword nInd = geno.nInd;
   //Output data
-  arma::field<arma::Cube<unsigned char> > output(nChr);
+  arma::field<arma::Mat<unsigned char> > gametes(nChr);
   RecHist hist;
   if(trackRec){
     hist.setSize(nInd*nDH,nChr,2);
@@ -1263,22 +1426,22 @@ Rcpp::List createDH2(
 #endif
   for(arma::uword chr=0; chr<nChr; ++chr){ //Chromosome loop
     arma::Mat<int> histMat;
-    arma::uword nBins = geno(chr).n_rows;
-    arma::Cube<unsigned char> tmp(nBins,2,nInd*nDH);
+    arma::uword nBins = geno.nBins[chr];
+    gametes(chr).set_size(nBins,nInd*nDH);
     arma::Col<unsigned char> gamete(nBins);
     arma::uvec x = {0,1};
     for(arma::uword ind=0; ind<nInd; ++ind){ //Individual loop
       for(arma::uword i=0; i<nDH; ++i){ //nDH loop
         x = shuffle(x);
-        bivalent(geno(chr).slice(ind).col(x(0)),
-                 geno(chr).slice(ind).col(x(1)),
+        bivalent(geno.haploCol(chr,x(0),ind),
+                 geno.haploCol(chr,x(1),ind),
                  genMap(chr),
                  v,
                  p,
                  gamete,
                  histMat);
+        gametes(chr).col(i+ind*nDH) = gamete;
         for(arma::uword j=0; j<2; ++j){ //ploidy loop
-          tmp.slice(i+ind*nDH).col(j) = gamete;
           if(trackRec){
             if((x(0)==1) & (j==0)){
               histMat.col(0).transform([](int val){return val%2+1;});
@@ -1288,8 +1451,12 @@ Rcpp::List createDH2(
         } //End ploidy loop
       } //End nDH loop
     } //End individual loop
-    output(chr) = tmp;
   } //End chromosome loop
+  Rcpp::List output(nChr);
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    output[chr] = poolInbredGeno(gametes(chr).memptr(), geno.nBins[chr], 
+                                 2, nInd*nDH);
+  }
   if(trackRec){
     return Rcpp::List::create(Rcpp::Named("geno")=output,
                               Rcpp::Named("recHist")=hist.hist);
@@ -1300,12 +1467,14 @@ Rcpp::List createDH2(
 // Samples gametes from individuals
 // [[Rcpp::export]]
 Rcpp::List createReducedGenome(
-    const arma::field<arma::Cube<unsigned char> >& geno, 
+    SEXP genoList, 
     arma::uword nProgeny, const arma::field<arma::vec>& genMap, 
     double v, double p, bool trackRec, arma::uword ploidy,  
     arma::vec& centromere, double quadProb, int nThreads){
-  arma::uword nChr = geno.n_elem;
-  arma::uword nInd = geno(0).n_slices;
+  // Parent haplotypes are read in place, see GenoView
+  GenoView geno(genoList);
+  arma::uword nChr = geno.nChr;
+  arma::uword nInd = geno.nInd;
   //Output data
   arma::field<arma::Cube<unsigned char> > output(nChr);
   RecHist hist;
@@ -1321,7 +1490,7 @@ Rcpp::List createReducedGenome(
   for(arma::uword chr=0; chr<nChr; ++chr){ //Chromosome loop
     arma::vec u(1);
     arma::Mat<int> hist1, hist2;
-    arma::uword nBins = geno(chr).n_rows;
+    arma::uword nBins = geno.nBins[chr];
     arma::Cube<unsigned char> tmpGeno(nBins,ploidy/2,nInd*nProgeny);
     arma::Col<unsigned char> gamete1(nBins), gamete2(nBins);
     arma::uvec x(ploidy);
@@ -1336,8 +1505,8 @@ Rcpp::List createReducedGenome(
           u.randu();
           if(u(0)>quadProb){
             //Bivalent 1
-            bivalent(geno(chr).slice(par).col(x(y)),
-                     geno(chr).slice(par).col(x(y+1)),
+            bivalent(geno.haploCol(chr,x(y),par),
+                     geno.haploCol(chr,x(y+1),par),
                      genMap(chr),
                      v,
                      p,
@@ -1353,8 +1522,8 @@ Rcpp::List createReducedGenome(
             ++progenyChr;
             
             //Bivalent 2
-            bivalent(geno(chr).slice(par).col(x(y+2)),
-                     geno(chr).slice(par).col(x(y+3)),
+            bivalent(geno.haploCol(chr,x(y+2),par),
+                     geno.haploCol(chr,x(y+3),par),
                      genMap(chr),
                      v,
                      p,
@@ -1370,10 +1539,10 @@ Rcpp::List createReducedGenome(
             ++progenyChr;
           }else{
             //Quadrivalent
-            quadrivalent(geno(chr).slice(par).col(x(y)),
-                         geno(chr).slice(par).col(x(y+1)),
-                         geno(chr).slice(par).col(x(y+2)),
-                         geno(chr).slice(par).col(x(y+3)),
+            quadrivalent(geno.haploCol(chr,x(y),par),
+                         geno.haploCol(chr,x(y+1),par),
+                         geno.haploCol(chr,x(y+2),par),
+                         geno.haploCol(chr,x(y+3),par),
                          genMap(chr),
                          centromere(chr),
                          v,
@@ -1398,8 +1567,8 @@ Rcpp::List createReducedGenome(
           }
         }else{
           //Bivalent
-          bivalent(geno(chr).slice(par).col(x(y)),
-                   geno(chr).slice(par).col(x(y+1)),
+          bivalent(geno.haploCol(chr,x(y),par),
+                   geno.haploCol(chr,x(y+1),par),
                    genMap(chr),
                    v,
                    p,
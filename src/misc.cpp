@@ -32,49 +32,6 @@ arma::mat popVar(const arma::mat& X) {
   }
 }
 
-// Merges geno objects, i.e. fields containing cubes of unsigned char
-// [[Rcpp::export]]
-arma::field<arma::Cube<unsigned char> > mergeGeno(
-    const arma::field<arma::Cube<unsigned char> >& x, 
-    const arma::field<arma::Cube<unsigned char> >& y){
-  arma::uword nChr = x.n_elem;
-  arma::field<arma::Cube<unsigned char> > z(nChr);
-  for(arma::uword i=0; i<nChr; ++i){
-    z(i) = arma::join_slices(x(i),y(i));
-  }
-  return z;
-}
-
-// Merges multiple geno objects contained a list of Class-Pop
-// [[Rcpp::export]]
-arma::field<arma::Cube<unsigned char> > mergeMultGeno(Rcpp::List& popList,
-                                                      arma::uvec nInd,
-                                                      arma::uvec nBin,
-                                                      arma::uword ploidy){
-  arma::field<arma::Cube<unsigned char> > output(nBin.n_elem);
-  arma::uword nTot = sum(nInd);
-  arma::uword nPop = nInd.n_elem;
-  // Allocate output
-  for(arma::uword chr=0; chr<nBin.n_elem; ++chr){
-    output(chr).set_size(nBin(chr),ploidy,nTot);
-  }
-  // Add individual genotypes
-  arma::uword startInd=0, endInd=0;
-  for(arma::uword i=0; i<nPop; ++i){
-    if(nInd(i)>0){
-      endInd += nInd(i)-1;
-      Rcpp::S4 pop = popList[i];
-      arma::field<arma::Cube<unsigned char> >geno = pop.slot("geno");
-      for(arma::uword chr=0; chr<nBin.n_elem; ++chr){
-        output(chr).slices(startInd,endInd) = geno(chr);
-      }
-      startInd += nInd(i);
-      endInd = startInd;
-    }
-  }
-  return output;
-}
-
 // Merges a list of integer matrices
 // [[Rcpp::export]]
 arma::Mat<int> mergeMultIntMat(const arma::field<arma::Mat<int> >& X,
@@ -9,5 +9,6 @@ arma::umat sampHalfDialComb(arma::uword nLevel, arma::uword n);
 double choose(double n, double k);
 std::bitset<8> toBits(unsigned char byte);
 unsigned char toByte(std::bitset<8> bits);
+int getNumThreads();
 
 #endif
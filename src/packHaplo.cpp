@@ -1,84 +1,172 @@
 #include "alphasimr.h"
+#include <cstring>
+#include <stdint.h>
 
-// [[Rcpp::export]]
-arma::Cube<unsigned char> packHaplo(arma::Mat<unsigned char>& haplo,
-                                    arma::uword ploidy, bool inbred){
-  arma::uword nHap = haplo.n_rows;
-  arma::uword nInd;
-  if(inbred){
-    nInd = haplo.n_rows;
-  }else{
-    if(haplo.n_rows%ploidy != 0){
-      Rcpp::stop("Number of rows not a factor of ploidy");
+// Loads 8 bytes into a word with byte k in bits 8k to 8k+7
+inline uint64_t loadLanes(const unsigned char* x){
+  uint64_t word;
+  std::memcpy(&word, x, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  return word;
+}
+
+// Sets each byte of a word to 1 if it is nonzero and 0 otherwise
+inline uint64_t laneNonzero(uint64_t word){
+  const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+  return ((((word & low7) + low7) | word) >> 7) & 0x0101010101010101ULL;
+}
+
+// Packs bins firstBin to nBins-1 of a block of haplotypes one locus
+// at a time. Any nonzero value is treated as a 1.
+template <typename T>
+void packBins(const T* haplo, arma::uword hapStride,
+              arma::uword locusStride, arma::uword nHap,
+              arma::uword nLoci, arma::uword firstBin,
+              unsigned char* output){
+  arma::uword nBins = (nLoci+7)/8;
+  for(arma::uword h=0; h<nHap; ++h){
+    const T* x = haplo + h*hapStride;
+    unsigned char* out = output + h*nBins;
+    for(arma::uword j=firstBin; j<nBins; ++j){
+      arma::uword nBits = std::min<arma::uword>(8, nLoci-8*j);
+      unsigned char byte = 0;
+      for(arma::uword k=0; k<nBits; ++k){
+        if(x[(8*j+k)*locusStride] != 0){
+          byte |= static_cast<unsigned char>(1u<<k);
+        }
+      }
+      out[j] = byte;
     }
-    nInd = haplo.n_rows/ploidy;
   }
-  arma::uword nLoci = haplo.n_cols;
-  arma::uword nBins = nLoci/8;
-  if((nLoci%8) > 0){
-    ++nBins;
+}
+
+// Packs a block of at most 8 haplotypes into consecutive columns of 
+// output with nBins rows
+template <typename T>
+void packBlock(const T* haplo, arma::uword hapStride,
+               arma::uword locusStride, arma::uword nHap,
+               arma::uword nLoci, unsigned char* output){
+  packBins(haplo, hapStride, locusStride, nHap, nLoci, 0, output);
+}
+
+// Raw input packs whole bins with word operations. Full blocks of 8 
+// haplotypes stored contiguously by site, as in R matrices and MaCS 
+// output, are packed with an 8x8 bit transpose.
+template <>
+void packBlock(const unsigned char* haplo, arma::uword hapStride,
+               arma::uword locusStride, arma::uword nHap,
+               arma::uword nLoci, unsigned char* output){
+  arma::uword nBins = (nLoci+7)/8;
+  arma::uword nFull = nLoci/8;
+  if((hapStride==1) && (nHap==8)){
+    for(arma::uword j=0; j<nFull; ++j){
+      uint64_t bits = 0;
+      for(arma::uword k=0; k<8; ++k){
+        bits |= laneNonzero(loadLanes(haplo + (8*j+k)*locusStride)) << k;
+      }
+      for(arma::uword h=0; h<8; ++h){
+        output[j + h*nBins] =
+          static_cast<unsigned char>(bits >> (8*h));
+      }
+    }
+  }else{
+    nFull = 0;
   }
-  arma::Cube<unsigned char> output(nBins,ploidy,nInd);
-  arma::uword chr=0;
-  arma::uword locus;
-  std::bitset<8> workBits;
-  for(arma::uword i=0; i<nHap; ++i){
+  packBins(haplo, hapStride, locusStride, nHap, nLoci, nFull, output);
+}
+
+// Converts a list of haplotype matrices, one per chromosome, to bit
+// packed geno arrays. Chromosomes and blocks of 8 haplotypes are
+// packed in parallel. Inbred individuals have each haplotype packed 
+// once and are returned as pooled arrays.
+// [[Rcpp::export]]
+Rcpp::List packHaplo(Rcpp::List haplotypes, arma::uword ploidy,
+                     bool inbred, int nThreads=1){
+  arma::uword nChr = haplotypes.size();
+  Rcpp::List output(nChr);
+  std::vector<int> type(nChr);
+  std::vector<const void*> input(nChr);
+  std::vector<arma::uword> nHap(nChr), nLoci(nChr);
+  std::vector<unsigned char*> geno(nChr);
+  // Work is split into blocks of 8 haplotypes on each chromosome
+  std::vector<arma::uword> blockChr, blockHap;
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    SEXP x = haplotypes[chr];
+    if(!Rf_isMatrix(x)){
+      Rcpp::stop("Haplotypes must be matrices");
+    }
+    // Data pointers are taken here, as the R API can't be called
+    // from the parallel region
+    type[chr] = TYPEOF(x);
+    switch(type[chr]){
+    case RAWSXP:
+      input[chr] = RAW(x);
+      break;
+    case LGLSXP:
+      input[chr] = LOGICAL(x);
+      break;
+    case INTSXP:
+      input[chr] = INTEGER(x);
+      break;
+    case REALSXP:
+      input[chr] = REAL(x);
+      break;
+    default:
+      Rcpp::stop("Haplotypes must be raw, logical, integer or numeric");
+    }
+    nHap[chr] = Rf_nrows(x);
+    nLoci[chr] = Rf_ncols(x);
+    arma::uword nInd;
     if(inbred){
-      for(chr=0; chr<ploidy; ++chr){
-        locus = 0;
-        
-        // Fill in bins known to be complete
-        if(nBins > 1){
-          for(arma::uword j=0; j<(nBins-1); ++j){
-            for(arma::uword k=0; k<8; ++k){
-              workBits[k] = haplo(i,locus);
-              ++locus;
-            }
-            output.slice(i).col(chr).row(j) = 
-              toByte(workBits);
-          }
-        }
-        
-        // Fill in potentially incomplete bins
-        for(arma::uword k=0; k<8; ++k){
-          if(locus<nLoci){
-            workBits[k] = haplo(i,locus);
-            ++locus;
-          }else{
-            workBits[k] = 0;
-          }
-        }
-        output.slice(i).col(chr).row(nBins-1) = 
-          toByte(workBits);
-      }
+      nInd = nHap[chr];
     }else{
-      locus = 0;
-      
-      // Fill in bins known to be complete
-      if(nBins > 1){
-        for(arma::uword j=0; j<(nBins-1); ++j){
-          for(arma::uword k=0; k<8; ++k){
-            workBits[k] = haplo(i,locus);
-            ++locus;
-          }
-          output.slice(i/ploidy).col(chr).row(j) = 
-            toByte(workBits);
-        }
-      }
-      
-      // Fill in potentially incomplete bins
-      for(arma::uword k=0; k<8; ++k){
-        if(locus<nLoci){
-          workBits[k] = haplo(i,locus);
-          ++locus;
-        }else{
-          workBits[k] = 0;
-        }
+      if(nHap[chr]%ploidy != 0){
+        Rcpp::stop("Number of rows not a factor of ploidy");
       }
-      output.slice(i/ploidy).col(chr).row(nBins-1) = 
-        toByte(workBits);
-      ++chr;
-      chr = chr%ploidy; 
+      nInd = nHap[chr]/ploidy;
+    }
+    arma::uword nBins = (nLoci[chr]+7)/8;
+    Rcpp::RawVector chrGeno(nBins*nHap[chr]);
+    if(!inbred){
+      chrGeno.attr("dim") = Rcpp::Dimension(nBins, ploidy, nInd);
+    }
+    geno[chr] = RAW(chrGeno);
+    output[chr] = chrGeno;
+    for(arma::uword h=0; h<nHap[chr]; h+=8){
+      blockChr.push_back(chr);
+      blockHap.push_back(h);
+    }
+  }
+  arma::uword nBlocks = blockChr.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword b=0; b<nBlocks; ++b){
+    arma::uword chr = blockChr[b];
+    arma::uword h = blockHap[b];
+    arma::uword n = std::min<arma::uword>(8, nHap[chr]-h);
+    arma::uword nBins = (nLoci[chr]+7)/8;
+    unsigned char* out = geno[chr] + h*nBins;
+    switch(type[chr]){
+    case RAWSXP:
+      packBlock(static_cast<const unsigned char*>(input[chr])+h, 1,
+                nHap[chr], n, nLoci[chr], out);
+      break;
+    case REALSXP:
+      packBlock(static_cast<const double*>(input[chr])+h, 1,
+                nHap[chr], n, nLoci[chr], out);
+      break;
+    default:
+      packBlock(static_cast<const int*>(input[chr])+h, 1,
+                nHap[chr], n, nLoci[chr], out);
+    }
+  }
+  if(inbred){
+    for(arma::uword chr=0; chr<nChr; ++chr){
+      output[chr] = poolInbredGeno(geno[chr], (nLoci[chr]+7)/8, 
+                                   ploidy, nHap[chr]);
     }
   }
   return output;
@@ -0,0 +1,362 @@
+// Positional Burrows-Wheeler transform (PBWT) of haplotypes
+// Durbin (2014) Efficient haplotype matching and storage using the
+// positional Burrows-Wheeler transform. Bioinformatics 30:1266-1272
+//
+// Haplotypes are sorted by their reversed prefixes at every locus, so
+// haplotypes sharing a segment ending at the locus are adjacent and the
+// alleles of a locus, taken in that order, form long runs. Each locus is
+// stored as the allele of its first run and the run lengths as variable
+// length integers. The sort order is stored every blockSize loci, which
+// allows decoding a locus by advancing the order from the preceding
+// checkpoint.
+#include "alphasimr.h"
+#include <stdint.h>
+
+// Appends x as a variable length integer, 7 bits per byte
+void putVarint(std::vector<unsigned char>& output, uint64_t x){
+  while(x >= 128){
+    output.push_back(static_cast<unsigned char>(x | 128));
+    x >>= 7;
+  }
+  output.push_back(static_cast<unsigned char>(x));
+}
+
+uint64_t getVarint(const unsigned char*& input){
+  uint64_t x = 0;
+  int shift = 0;
+  while(*input & 128){
+    x |= uint64_t(*input & 127) << shift;
+    shift += 7;
+    ++input;
+  }
+  x |= uint64_t(*input) << shift;
+  ++input;
+  return x;
+}
+
+// Compressed loci of one chromosome
+struct PbwtChr{
+  const unsigned char* runs;
+  const double* colStart; // Offset of each locus in runs
+  const unsigned char* first; // Allele of each locus' first run
+  const int* prefix; // Sort order at each checkpoint, nHap per checkpoint
+  uint64_t nHap;
+  uint64_t blockSize;
+};
+
+// Alleles of locus k in the sort order of the locus
+void decodeColumn(const PbwtChr& pbwt, uint64_t k,
+                  std::vector<unsigned char>& alleles){
+  const unsigned char* input = pbwt.runs + uint64_t(pbwt.colStart[k]);
+  unsigned char allele = pbwt.first[k];
+  uint64_t i = 0;
+  while(i < pbwt.nHap){
+    uint64_t n = getVarint(input);
+    std::fill(alleles.begin()+i, alleles.begin()+i+n, allele);
+    i += n;
+    allele ^= 1;
+  }
+}
+
+// Sort order of the next locus, a stable partition by allele
+void advanceOrder(std::vector<int>& order, std::vector<int>& buffer,
+                  const std::vector<unsigned char>& alleles){
+  uint64_t nHap = order.size();
+  uint64_t u = 0;
+  for(uint64_t i=0; i<nHap; ++i){
+    if(alleles[i] == 0){
+      buffer[u++] = order[i];
+    }
+  }
+  for(uint64_t i=0; i<nHap; ++i){
+    if(alleles[i] == 1){
+      buffer[u++] = order[i];
+    }
+  }
+  order.swap(buffer);
+}
+
+// Builds the PBWT of nLoci loci from packed haplotypes
+void buildPbwt(const std::vector<const unsigned char*>& haplos,
+               uint64_t nLoci, uint64_t blockSize,
+               std::vector<unsigned char>& runs,
+               std::vector<double>& colStart,
+               std::vector<unsigned char>& first,
+               std::vector<int>& prefix){
+  uint64_t nHap = haplos.size();
+  std::vector<int> order(nHap), buffer(nHap);
+  std::vector<unsigned char> alleles(nHap);
+  for(uint64_t i=0; i<nHap; ++i){
+    order[i] = i;
+  }
+  colStart.resize(nLoci+1);
+  first.resize(nLoci);
+  for(uint64_t k=0; k<nLoci; ++k){
+    if(k%blockSize == 0){
+      prefix.insert(prefix.end(), order.begin(), order.end());
+    }
+    colStart[k] = runs.size();
+    for(uint64_t i=0; i<nHap; ++i){
+      alleles[i] = (haplos[order[i]][k/8] >> (k%8)) & 1;
+    }
+    first[k] = (nHap > 0) ? alleles[0] : 0;
+    uint64_t runLength = 0;
+    for(uint64_t i=0; i<nHap; ++i){
+      if((i > 0) && (alleles[i] != alleles[i-1])){
+        putVarint(runs, runLength);
+        runLength = 0;
+      }
+      ++runLength;
+    }
+    if(nHap > 0){
+      putVarint(runs, runLength);
+    }
+    advanceOrder(order, buffer, alleles);
+  }
+  colStart[nLoci] = runs.size();
+}
+
+// Decodes the loci in sortedLoci, which must be sorted, calling
+// output(hap, j, allele) for every haplotype of sortedLoci[j].
+// Each block between checkpoints is decoded independently.
+template <typename OutputT>
+void decodePbwt(const PbwtChr& pbwt, const std::vector<uint64_t>& sortedLoci,
+                OutputT& output, int nThreads){
+  // First selected locus of every block
+  std::vector<uint64_t> blockFirst;
+  for(uint64_t j=0; j<sortedLoci.size(); ++j){
+    if((j == 0) ||
+       (sortedLoci[j]/pbwt.blockSize != sortedLoci[j-1]/pbwt.blockSize)){
+      blockFirst.push_back(j);
+    }
+  }
+  blockFirst.push_back(sortedLoci.size());
+  uint64_t nBlocks = blockFirst.size()-1;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(uint64_t b=0; b<nBlocks; ++b){
+    uint64_t checkpoint = sortedLoci[blockFirst[b]]/pbwt.blockSize;
+    std::vector<int> order(pbwt.prefix + checkpoint*pbwt.nHap,
+                           pbwt.prefix + (checkpoint+1)*pbwt.nHap);
+    std::vector<int> buffer(pbwt.nHap);
+    std::vector<unsigned char> alleles(pbwt.nHap);
+    uint64_t k = checkpoint*pbwt.blockSize;
+    for(uint64_t j=blockFirst[b]; j<blockFirst[b+1]; ++j){
+      for(; k<sortedLoci[j]; ++k){
+        decodeColumn(pbwt, k, alleles);
+        advanceOrder(order, buffer, alleles);
+      }
+      decodeColumn(pbwt, k, alleles);
+      for(uint64_t i=0; i<pbwt.nHap; ++i){
+        output(order[i], j, alleles[i]);
+      }
+    }
+  }
+}
+
+// Finds the longest match ending at each locus between each query
+// haplotype and the stored haplotypes, using the divergence array
+// of the PBWT. length and match are nQuery by nLoci, column major.
+void matchPbwt(const PbwtChr& pbwt, uint64_t nLoci,
+               const unsigned char* query, uint64_t nQuery,
+               int* length, int* match, int nThreads){
+  uint64_t nHap = pbwt.nHap;
+  std::vector<int> order(nHap), buffer(nHap);
+  std::vector<int> div(nHap+1,0), divBuffer(nHap+1);
+  std::vector<unsigned char> alleles(nHap);
+  std::vector<uint64_t> nZeros(nHap+1);
+  for(uint64_t i=0; i<nHap; ++i){
+    order[i] = i;
+  }
+  // Position of each query in the sort order and the start of its
+  // matches with the haplotypes above and below that position
+  std::vector<uint64_t> pos(nQuery,0), startUp(nQuery,0),
+    startDown(nQuery,0);
+  for(uint64_t k=0; k<nLoci; ++k){
+    decodeColumn(pbwt, k, alleles);
+    nZeros[0] = 0;
+    for(uint64_t i=0; i<nHap; ++i){
+      nZeros[i+1] = nZeros[i] + (alleles[i] == 0);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+    for(uint64_t q=0; q<nQuery; ++q){
+      unsigned char x = query[q+nQuery*k];
+      uint64_t t = pos[q];
+      // Nearest haplotypes with the same allele above and below
+      uint64_t newUp = k+1, newDown = k+1;
+      int hapUp = -1, hapDown = -1;
+      uint64_t m = startUp[q];
+      for(uint64_t i=t; i>0; --i){
+        if(alleles[i-1] == x){
+          newUp = m;
+          hapUp = order[i-1];
+          break;
+        }
+        m = std::max(m, uint64_t(div[i-1]));
+      }
+      m = startDown[q];
+      for(uint64_t i=t; i<nHap; ++i){
+        if(alleles[i] == x){
+          newDown = m;
+          hapDown = order[i];
+          break;
+        }
+        m = std::max(m, uint64_t(div[i+1]));
+      }
+      pos[q] = (x == 0) ? nZeros[t] : nZeros[nHap]+t-nZeros[t];
+      startUp[q] = newUp;
+      startDown[q] = newDown;
+      if(newUp <= newDown){
+        length[q+nQuery*k] = k+1-newUp;
+        match[q+nQuery*k] = hapUp;
+      }else{
+        length[q+nQuery*k] = k+1-newDown;
+        match[q+nQuery*k] = hapDown;
+      }
+    }
+    // Update sort order and divergence array, div[i] is the start of
+    // the match between order[i-1] and order[i]
+    uint64_t u = 0, v = nZeros[nHap];
+    uint64_t p = k+1, r = k+1;
+    for(uint64_t i=0; i<nHap; ++i){
+      p = std::max(p, uint64_t(div[i]));
+      r = std::max(r, uint64_t(div[i]));
+      if(alleles[i] == 0){
+        buffer[u] = order[i];
+        divBuffer[u] = p;
+        ++u;
+        p = 0;
+      }else{
+        buffer[v] = order[i];
+        divBuffer[v] = r;
+        ++v;
+        r = 0;
+      }
+    }
+    order.swap(buffer);
+    div.swap(divBuffer);
+  }
+}
+
+// Haplotype pointers of a chromosome in GenoView order
+std::vector<const unsigned char*> chrHaplos(const GenoView& geno,
+                                            arma::uword chr){
+  std::vector<const unsigned char*> haplos(geno.ploidy*geno.nInd);
+  for(arma::uword ind=0; ind<geno.nInd; ++ind){
+    for(arma::uword p=0; p<geno.ploidy; ++p){
+      haplos[p+geno.ploidy*ind] = geno.haplo(chr, p, ind);
+    }
+  }
+  return haplos;
+}
+
+PbwtChr asPbwtChr(const Rcpp::List& chrData, arma::uword nHap,
+                  arma::uword blockSize){
+  SEXP runs = chrData["runs"];
+  SEXP colStart = chrData["colStart"];
+  SEXP first = chrData["first"];
+  SEXP prefix = chrData["prefix"];
+  PbwtChr pbwt;
+  pbwt.runs = RAW(runs);
+  pbwt.colStart = REAL(colStart);
+  pbwt.first = RAW(first);
+  pbwt.prefix = INTEGER(prefix);
+  pbwt.nHap = nHap;
+  pbwt.blockSize = blockSize;
+  return pbwt;
+}
+
+// Compresses the first nLoci(chr) loci of each chromosome
+// [[Rcpp::export]]
+Rcpp::List pbwtCompress(SEXP geno, arma::uvec nLoci,
+                        int blockSize, int nThreads){
+  GenoView view(geno);
+  arma::uword nChr = view.nChr;
+  std::vector<std::vector<unsigned char> > runs(nChr), first(nChr);
+  std::vector<std::vector<double> > colStart(nChr);
+  std::vector<std::vector<int> > prefix(nChr);
+  if(nChr < static_cast<arma::uword>(nThreads) ){
+    nThreads = nChr;
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    buildPbwt(chrHaplos(view, chr), nLoci(chr), blockSize,
+              runs[chr], colStart[chr], first[chr], prefix[chr]);
+  }
+  Rcpp::List output(nChr);
+  for(arma::uword chr=0; chr<nChr; ++chr){
+    Rcpp::IntegerVector chrPrefix(prefix[chr].begin(), prefix[chr].end());
+    chrPrefix.attr("dim") = Rcpp::Dimension(view.ploidy*view.nInd,
+                  prefix[chr].size()/std::max(view.ploidy*view.nInd,
+                                              arma::uword(1)));
+    output[chr] = Rcpp::List::create(
+      Rcpp::Named("runs")=Rcpp::RawVector(runs[chr].begin(), runs[chr].end()),
+      Rcpp::Named("colStart")=Rcpp::wrap(colStart[chr]),
+      Rcpp::Named("first")=Rcpp::RawVector(first[chr].begin(), first[chr].end()),
+      Rcpp::Named("prefix")=chrPrefix);
+  }
+  return output;
+}
+
+// Sums alleles into a genotype matrix
+struct GenoOutput{
+  arma::Mat<unsigned char>& geno;
+  const std::vector<arma::uword>& column;
+  arma::uword ploidy;
+  void operator()(int hap, uint64_t j, unsigned char allele){
+    geno(hap/ploidy, column[j]) += allele;
+  }
+};
+
+// Decodes the same loci and output as getGeno
+// [[Rcpp::export]]
+arma::Mat<unsigned char> pbwtGeno(Rcpp::List pbwt, arma::uword nInd,
+                                  arma::uword ploidy, int blockSize,
+                                  const arma::Col<int>& lociPerChr,
+                                  arma::uvec lociLoc, int nThreads){
+  // R to C++ index correction
+  lociLoc -= 1;
+  arma::Mat<unsigned char> output(nInd,arma::sum(lociPerChr),arma::fill::zeros);
+  arma::uword loc1 = 0;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    if(lociPerChr(chr) > 0){
+      // Decode in locus order, keeping track of the output column
+      arma::uvec chrLoci = lociLoc.subvec(loc1, loc1+lociPerChr(chr)-1);
+      arma::uvec sorted = arma::sort_index(chrLoci);
+      std::vector<uint64_t> sortedLoci(sorted.n_elem);
+      std::vector<arma::uword> column(sorted.n_elem);
+      for(arma::uword j=0; j<sorted.n_elem; ++j){
+        sortedLoci[j] = chrLoci(sorted(j));
+        column[j] = loc1+sorted(j);
+      }
+      GenoOutput geno = {output, column, ploidy};
+      decodePbwt(asPbwtChr(pbwt[chr], nInd*ploidy, blockSize),
+                 sortedLoci, geno, nThreads);
+      loc1 += lociPerChr(chr);
+    }
+  }
+  return output;
+}
+
+// Longest matches of query haplotypes, nQuery by nLoci of 0/1,
+// against the haplotypes of one chromosome
+// [[Rcpp::export]]
+Rcpp::List pbwtMatch(Rcpp::List pbwt, arma::uword nHap, int blockSize,
+                     const arma::Mat<unsigned char>& query, int nThreads){
+  Rcpp::IntegerMatrix length(query.n_rows, query.n_cols);
+  Rcpp::IntegerMatrix match(query.n_rows, query.n_cols);
+  matchPbwt(asPbwtChr(pbwt, nHap, blockSize), query.n_cols,
+            query.memptr(), query.n_rows,
+            length.begin(), match.begin(), nThreads);
+  // C++ to R index correction, no match is NA
+  for(R_xlen_t i=0; i<match.size(); ++i){
+    match[i] = (match[i] < 0) ? NA_INTEGER : match[i]+1;
+  }
+  return Rcpp::List::create(Rcpp::Named("length")=length,
+                            Rcpp::Named("match")=match);
+}
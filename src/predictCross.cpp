@@ -0,0 +1,145 @@
+#include "alphasimr.h"
+
+// Correlation between a parent's gametic alleles at two loci d Morgans
+// apart, 1-2r, for Haldane's or Kosambi's map function
+inline double linkage(double d, bool haldane){
+  if(haldane){
+    return std::exp(-2.0*d);
+  }
+  return 1.0-std::tanh(2.0*d);
+}
+
+// Additive genetic variance among a parent's gametes. Only loci
+// where the parent is heterozygous contribute and loci on different
+// chromosomes are unlinked.
+double gameteVar(const arma::Mat<unsigned char>& maternalGeno,
+                 const arma::Mat<unsigned char>& paternalGeno,
+                 arma::uword ind, const arma::vec& a,
+                 const arma::vec& pos, const arma::Col<int>& lociPerChr,
+                 bool haldane){
+  double output = 0;
+  std::vector<double> w, wPos;
+  arma::uword k = 0;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    w.clear();
+    wPos.clear();
+    for(int i=0; i<lociPerChr(chr); ++i, ++k){
+      int delta = int(maternalGeno(ind,k))-int(paternalGeno(ind,k));
+      if(delta!=0){
+        w.push_back(a(k)*double(delta)/2.0);
+        wPos.push_back(pos(k));
+      }
+    }
+    for(arma::uword i=0; i<w.size(); ++i){
+      output += w[i]*w[i];
+      for(arma::uword j=i+1; j<w.size(); ++j){
+        output += 2.0*w[i]*w[j]*linkage(std::abs(wPos[j]-wPos[i]), haldane);
+      }
+    }
+  }
+  return output;
+}
+
+// Predicts the mean and genetic variance of F1 progeny from crosses
+// of diploid parents without simulating them. The mean includes
+// additive and dominance effects. The variance is the sum of the
+// additive variances of both parents' gametes, accounting for linkage
+// between heterozygous QTL on the same chromosome.
+// [[Rcpp::export]]
+Rcpp::List predictCrossGv(const Rcpp::S4& trait,
+                          const Rcpp::S4& pop,
+                          arma::uvec mother,
+                          arma::uvec father,
+                          Rcpp::List femaleMap,
+                          Rcpp::List maleMap,
+                          bool haldane,
+                          int nThreads){
+  mother -= 1; // R to C++
+  father -= 1; // R to C++
+  arma::uword ploidy = pop.slot("ploidy");
+  if(ploidy!=2){
+    Rcpp::stop("Cross prediction requires diploid parents");
+  }
+  arma::uword nInd = pop.slot("nInd");
+  arma::uword nCross = mother.n_elem;
+  bool hasD = trait.hasSlot("domEff");
+  const arma::Col<int>& lociPerChr = trait.slot("lociPerChr");
+  arma::uvec lociLoc = trait.slot("lociLoc");
+  arma::uword nLoci = lociLoc.n_elem;
+  arma::vec a,d;
+  a = Rcpp::as<arma::vec>(trait.slot("addEff"));
+  if(hasD){
+    d = Rcpp::as<arma::vec>(trait.slot("domEff"));
+  }else{
+    d.zeros(nLoci);
+  }
+
+  // Map positions of QTL
+  arma::vec posF(nLoci), posM(nLoci);
+  arma::uword k = 0;
+  for(arma::uword chr=0; chr<lociPerChr.n_elem; ++chr){
+    Rcpp::NumericVector chrMapF = femaleMap[chr];
+    Rcpp::NumericVector chrMapM = maleMap[chr];
+    for(int i=0; i<lociPerChr(chr); ++i, ++k){
+      posF(k) = chrMapF[lociLoc(k)-1];
+      posM(k) = chrMapM[lociLoc(k)-1];
+    }
+  }
+
+  arma::Mat<unsigned char> maternalGeno = getMaternalGeno(GenoView(SEXP(pop.slot("geno"))),
+                                                          lociPerChr, lociLoc, nThreads);
+  arma::Mat<unsigned char> paternalGeno = getPaternalGeno(GenoView(SEXP(pop.slot("geno"))),
+                                                          lociPerChr, lociLoc, nThreads);
+
+  // Frequency of the 1 allele in each parent's gametes
+  arma::mat q = (arma::conv_to<arma::mat>::from(maternalGeno) +
+    arma::conv_to<arma::mat>::from(paternalGeno))/2.0;
+
+  // Mean terms that depend on one parent
+  arma::vec s = q*(a+d);
+  double intercept = double(trait.slot("intercept")) - arma::accu(a);
+
+  // Gametic variances, only for individuals used as parents
+  std::vector<bool> useF(nInd,false), useM(nInd,false);
+  for(arma::uword i=0; i<nCross; ++i){
+    useF[mother(i)] = true;
+    useM[father(i)] = true;
+  }
+  arma::vec varF(nInd,arma::fill::zeros), varM(nInd,arma::fill::zeros);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+#endif
+  for(arma::uword ind=0; ind<nInd; ++ind){
+    if(useF[ind]){
+      varF(ind) = gameteVar(maternalGeno, paternalGeno, ind, a, posF,
+                            lociPerChr, haldane);
+    }
+    if(useM[ind]){
+      varM(ind) = gameteVar(maternalGeno, paternalGeno, ind, a, posM,
+                            lociPerChr, haldane);
+    }
+  }
+
+  arma::vec gvMean(nCross), gvVar(nCross);
+  arma::mat qt = q.t();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for(arma::uword i=0; i<nCross; ++i){
+    gvMean(i) = intercept + s(mother(i)) + s(father(i));
+    if(hasD){
+      // Dominance counts heterozygotes, which excludes 1/1 progeny
+      const double* qm = qt.colptr(mother(i));
+      const double* qf = qt.colptr(father(i));
+      double dSum = 0;
+      for(arma::uword j=0; j<nLoci; ++j){
+        dSum += d(j)*qm[j]*qf[j];
+      }
+      gvMean(i) -= 2.0*dSum;
+    }
+    gvVar(i) = varF(mother(i)) + varM(father(i));
+  }
+
+  return Rcpp::List::create(Rcpp::Named("mean")=gvMean,
+                            Rcpp::Named("var")=gvVar);
+}
@@ -12,9 +12,11 @@
 
 #include <boost/algorithm/string/split.hpp> // Include for boost::split
 #include <boost/algorithm/string/classification.hpp> // Include boost::for is_any_of
+#include <boost/algorithm/string/trim.hpp>
 #include "simulator.h"
 #include <boost/algorithm/string/split.hpp> // Include for boost::split
 #include "misc.h"
+#include "getGeno.h"
 
 const double Node::MAX_HEIGHT=1e50;
 
@@ -70,6 +72,53 @@ Configuration::~Configuration(){
   }
 }
 
+Configuration * Configuration::clone(long iSeed){
+  Configuration * pCopy = new Configuration();
+  pCopy->dTheta = dTheta;
+  pCopy->dGlobalMigration = dGlobalMigration;
+  pCopy->dRecombRateRAcrossSites = dRecombRateRAcrossSites;
+  pCopy->dGeneConvRatio = dGeneConvRatio;
+  pCopy->dSeqLength = dSeqLength;
+  pCopy->dBasesToTrack = dBasesToTrack;
+  pCopy->iSampleSize = iSampleSize;
+  pCopy->iIterations = iIterations;
+  pCopy->iGeneConvTract = iGeneConvTract;
+  pCopy->iTotalPops = iTotalPops;
+  pCopy->iRandomSeed = iSeed;
+  pCopy->bFlipAlleles = bFlipAlleles;
+  pCopy->bNewickFormat = bNewickFormat;
+  pCopy->bMigrationChangeEventDefined = bMigrationChangeEventDefined;
+  pCopy->dMigrationMatrix = dMigrationMatrix;
+  pCopy->pPopList = pPopList;
+  // events are reference counted without locking, so every copy 
+  // gets its own
+  pCopy->pEventList = new EventPtrList;
+  for (EventPtrList::iterator it=pEventList->begin();
+       it!=pEventList->end();++it){
+    pCopy->pEventList->push_back(EventPtr((*it)->clone()));
+  }
+  if (bVariableRecomb){
+    pCopy->bVariableRecomb = true;
+    pCopy->pHotSpotBinPtrList = new HotSpotBinPtrList;
+    for (HotSpotBinPtrList::iterator it=pHotSpotBinPtrList->begin();
+         it!=pHotSpotBinPtrList->end();++it){
+      pCopy->pHotSpotBinPtrList->push_back(
+          new HotSpotBin((*it)->dStart,(*it)->dEnd,(*it)->dRate));
+    }
+  }
+  if (bSNPAscertainment){
+    // bins hold counts that are updated during the simulation
+    pCopy->bSNPAscertainment = true;
+    pCopy->pAlleleFreqBinPtrSet = new AlleleFreqBinPtrSet;
+    for (AlleleFreqBinPtrSet::iterator it=pAlleleFreqBinPtrSet->begin();
+         it!=pAlleleFreqBinPtrSet->end();++it){
+      pCopy->pAlleleFreqBinPtrSet->insert(
+          new AlleleFreqBin((*it)->dStart,(*it)->dEnd,(*it)->dFreq));
+    }
+  }
+  return pCopy;
+}
+
 void Simulator::readInputParameters(CommandArguments arguments){
   unsigned int popId;
   
@@ -617,22 +666,53 @@ vector<AlphaSimRReturn> Simulator::beginSimulationMemory() {
   vector<AlphaSimRReturn> toRet;
   
   try {
-    RandNumGenerator *rg = new RandNumGenerator(pConfig->iRandomSeed);
+    RandNumGenerator rg(pConfig->iRandomSeed);
     for (unsigned int i = 0; i < pConfig->iIterations; ++i) {
-      GraphBuilder graphBuilder = GraphBuilder(pConfig, rg);
+      GraphBuilder graphBuilder = GraphBuilder(pConfig, &rg);
       graphBuilder.build();
       vector<AlphaSimRReturn> tmp = graphBuilder.getMutations();
       graphBuilder.printHaplotypes();
       toRet.insert(toRet.end(), tmp.begin(), tmp.end());
     }
-    delete rg;
   } catch (const char *message) {
-    Rcpp::Rcerr << "Simulator caught exception with message:" << endl << message << endl;
+    throw std::runtime_error(string("MaCS failed: ")+message);
   }
   return  toRet;
 }
 
 
+// Errors are rethrown as std::runtime_error, so they reach R instead 
+// of leaving an empty tree sequence. Rcpp::stop isn't used here, 
+// because these functions run inside OpenMP loops.
+void Simulator::beginSimulationTreeSeq(TreeSequence & treeSeq) {
+  try {
+    if (pConfig->iIterations!=1) {
+      throw "Tree sequence recording requires a single iteration";
+    }
+    RandNumGenerator rg(pConfig->iRandomSeed);
+    GraphBuilder graphBuilder = GraphBuilder(pConfig, &rg, &treeSeq);
+    graphBuilder.build();
+    graphBuilder.printHaplotypes();
+  } catch (const char *message) {
+    throw std::runtime_error(string("MaCS failed: ")+message);
+  }
+}
+
+
+void Simulator::beginSimulationHudson(TreeSequence & treeSeq) {
+  try {
+    if (pConfig->iIterations!=1) {
+      throw "Tree sequence recording requires a single iteration";
+    }
+    RandNumGenerator rg(pConfig->iRandomSeed);
+    HudsonBuilder hudsonBuilder(pConfig, &rg, &treeSeq);
+    hudsonBuilder.build();
+  } catch (const char *message) {
+    throw std::runtime_error(string("Hudson simulation failed: ")+message);
+  }
+}
+
+
 void Simulator::beginSimulation() {
   try {
     RandNumGenerator *rg = new RandNumGenerator(pConfig->iRandomSeed);
@@ -649,6 +729,17 @@ void Simulator::beginSimulation() {
 }
 
 Simulator::Simulator() {
+  pConfig = NULL;
+}
+
+Simulator::Simulator(Configuration * pConfig) {
+  this->pConfig = pConfig;
+}
+
+Configuration * Simulator::releaseConfiguration() {
+  Configuration * pOutput = pConfig;
+  pConfig = NULL;
+  return pOutput;
 }
 
 
@@ -658,9 +749,8 @@ Simulator::~Simulator() {
 
 // AlphaSimR specific functions
 
-vector<AlphaSimRReturn> runFromAlphaSimR(string in) {
+CommandArguments parseAlphaSimRArgs(string in) {
   vector<std::string> words;
-  Simulator simulator;
   
   if (in == ""){
     Rcpp::stop("Not enough args for macs call");
@@ -668,6 +758,7 @@ vector<AlphaSimRReturn> runFromAlphaSimR(string in) {
   if (in.empty()) {
     Rcpp::stop("Not enough args for macs call");
   }
+  boost::trim(in);
   boost::split(words, in, boost::is_any_of(", "), boost::token_compress_on);
   CommandArguments arguments;
   vector<string> subOption;
@@ -687,128 +778,295 @@ vector<AlphaSimRReturn> runFromAlphaSimR(string in) {
   if (arguments.size() == 0) {
     Rcpp::stop("Not enough args for macs call");
   }
-  
-  simulator.readInputParameters(arguments);
+  return arguments;
+}
+
+vector<AlphaSimRReturn> runFromAlphaSimR(string in) {
+  Simulator simulator;
+  simulator.readInputParameters(parseAlphaSimRArgs(in));
   vector<AlphaSimRReturn> test = simulator.beginSimulationMemory();
   return test;
 }
 
+// Parses a MaCS command once. The configuration is validated here, 
+// outside of any parallel section, and later copied for each chromosome.
+Configuration * parseMaCSConfig(string in) {
+  Simulator simulator;
+  simulator.readInputParameters(parseAlphaSimRArgs(in));
+  Configuration * pConfig = simulator.releaseConfiguration();
+  if (pConfig->iIterations!=1) {
+    delete pConfig;
+    Rcpp::stop("MaCS commands for AlphaSimR must use a single iteration");
+  }
+  return pConfig;
+}
+
+// Runs MaCS or the exact coalescent, recording the genealogy as a tree 
+// sequence instead of storing haplotypes for every segregating site.
+// The simulator takes ownership of pConfig.
+void runTreeSeq(Configuration * pConfig, TreeSequence & treeSeq, bool hudson) {
+  Simulator simulator(pConfig);
+  if (hudson) {
+    simulator.beginSimulationHudson(treeSeq);
+  } else {
+    simulator.beginSimulationTreeSeq(treeSeq);
+  }
+}
+
+// Creates an external pointer to a parsed MaCS command
 // [[Rcpp::export]]
-Rcpp::List MaCS(Rcpp::String args, arma::uvec maxSites, bool inbred, 
-                arma::uword ploidy, int nThreads, Rcpp::StringVector seed){
-  //Check input
+SEXP MaCSConfig(Rcpp::String args, bool hudson=false){
   string t = args;
   if (t == "") {
     Rcpp::stop("error passing argument string");
   }
+  Configuration * pConfig = parseMaCSConfig(args);
+  if (hudson && (pConfig->bVariableRecomb || pConfig->dGeneConvRatio>0. ||
+      pConfig->bSNPAscertainment)) {
+    delete pConfig;
+    Rcpp::stop("hot spots, gene conversion and SNP ascertainment are not supported with hudson=TRUE");
+  }
+  return Rcpp::XPtr<Configuration>(pConfig, true);
+}
+
+// Selects n of N sites, returned in ascending order with every subset 
+// equally likely (selection sampling). Uses the chromosome's own 
+// generator rather than R's, so chromosomes can be processed in parallel.
+vector<unsigned long> selectSites(unsigned long n, unsigned long N, 
+                                  RandNumGenerator & rg){
+  vector<unsigned long> output;
+  output.reserve(n);
+  for(unsigned long i=0; (i<N) && (output.size()<n); ++i){
+    if(double(N-i)*rg.unifRV() < double(n-output.size())){
+      output.push_back(i);
+    }
+  }
+  return output;
+}
+
+// Each chromosome's tree sequence is decoded and released within the 
+// chromosome's task, so only one tree sequence per thread is held at a 
+// time. Threads not needed for chromosomes decode the selected sites of 
+// a chromosome in parallel, split into windows of whole bins. 
+// seed holds a simulation seed for each chromosome followed by a site 
+// selection seed for each chromosome. Inbred individuals are decoded as 
+// a single haplotype each and returned as pooled arrays.
+// [[Rcpp::export]]
+Rcpp::List MaCS(SEXP config, arma::uvec maxSites, bool inbred, 
+                arma::uword ploidy, int nThreads, arma::uvec seed,
+                bool hudson=false){
+  Rcpp::XPtr<Configuration> pConfig(config);
   
   // Output objects
   arma::uword nChr = maxSites.n_elem;
+  if(seed.n_elem != 2*nChr){
+    Rcpp::stop("a simulation seed and a site selection seed are required for every chromosome");
+  }
   arma::field<arma::Cube<unsigned char> > geno(nChr);
   arma::field<arma::vec > genMap(nChr);
   
+  // Each chromosome gets its own copy of the configuration
+  std::vector<Configuration*> chrConfig(nChr);
+  for(arma::uword chr=0; chr<nChr; chr++){
+    chrConfig[chr] = pConfig->clone(seed(chr));
+  }
+  arma::uword nHap = pConfig->iSampleSize;
+  arma::uword nInd;
+  arma::uword decodePloidy;
+  if(inbred){
+    nInd = nHap;
+    decodePloidy = 1;
+  }else{
+    nInd = nHap/ploidy;
+    decodePloidy = ploidy;
+  }
+  
+  // Threads not needed for chromosomes are used for windows. A team 
+  // with a single thread isn't active, so the nested loop over windows 
+  // can still run in parallel when there is only one chromosome.
+  int nChrThreads = std::max(1, std::min(nThreads, int(nChr)));
+  arma::uword nWindows = std::max(1, nThreads/nChrThreads);
+  string errorMessage;
+  
   //Loop through chromosomes
 #ifdef _OPENMP
-#pragma omp parallel for schedule(static) num_threads(nThreads)
+#pragma omp parallel for schedule(static) num_threads(nChrThreads)
 #endif
   for(arma::uword chr=0; chr<nChr; chr++){
-    // Run MaCS and check for valid output
-    vector<AlphaSimRReturn> macsOutput;
-    macsOutput = runFromAlphaSimR(args+seed(chr));
-    
-    arma::uword nSites, nBins, nHap, nInd;
-    nSites = macsOutput.size();
-    nHap = macsOutput[0].haplotypes.size();
-    if(inbred){
-      nInd = nHap;
-    }else{
-      nInd = nHap/ploidy;
+    TreeSequence treeSeq;
+    try{
+      runTreeSeq(chrConfig[chr], treeSeq, hudson);
+    }catch(const std::exception & e){
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      errorMessage = e.what();
+      continue;
     }
-    arma::uvec selSites;
-    if(maxSites(chr)>0){
-      if(nSites<maxSites(chr)){
-        maxSites(chr) = nSites;
-      }
-      selSites = sampleInt(maxSites(chr),nSites);
-      nSites = maxSites(chr);
+    
+    // Select sites
+    unsigned long nSites = treeSeq.getTotalSites();
+    vector<unsigned long> selVec;
+    if((maxSites(chr)>0) && (maxSites(chr)<nSites)){
+      RandNumGenerator rg(seed(nChr+chr));
+      selVec = selectSites(maxSites(chr), nSites, rg);
     }else{
-      selSites.set_size(nSites);
-      for(arma::uword i=0; i<nSites; ++i)
-        selSites(i) = i;
+      selVec.resize(nSites);
+      for(unsigned long i=0; i<nSites; ++i)
+        selVec[i] = i;
     }
-    
-    // Fill genMap
+    nSites = selVec.size();
     genMap(chr).set_size(nSites);
     for(arma::uword site=0; site<nSites; ++site){
-      genMap(chr).at(site) = macsOutput[selSites(site)].length;
+      genMap(chr).at(site) = treeSeq.sitePosition[selVec[site]];
     }
     
-    // Fill Geno
-    nBins = nSites/8;
+    // Fill Geno, only the selected sites are decoded
+    arma::uword nBins = nSites/8;
     if((nSites%8) > 0){
       ++nBins;
     }
-    
-    geno(chr).set_size(nBins,ploidy,nInd);
-    arma::uword grp=0;
-    arma::uword locus;
-    std::bitset<8> workBits;
-    for(arma::uword i=0; i<nHap; ++i){
-      if(inbred){
-        for(grp=0; grp<ploidy; ++grp){
-          locus = 0;
-          // Fill in bins known to be complete
-          if(nBins > 1){
-            for(arma::uword j=0; j<(nBins-1); ++j){
-              for(arma::uword k=0; k<8; ++k){
-                workBits[k] = macsOutput[selSites(locus)].haplotypes[i];
-                ++locus;
-              }
-              geno(chr).slice(i).col(grp).row(j) = 
-                toByte(workBits);
-            }
-          }
-          // Fill in potentially incomplete bins
-          for(arma::uword k=0; k<8; ++k){
-            if(locus<nSites){
-              workBits[k] = macsOutput[selSites(locus)].haplotypes[i];
-              ++locus;
-            }else{
-              workBits[k] = 0;
-            }
-          }
-          geno(chr).slice(i).col(grp).row(nBins-1) = 
-            toByte(workBits);
-        }
-      }else{
-        locus = 0;
-        // Fill in bins known to be complete
-        if(nBins > 1){
-          for(arma::uword j=0; j<(nBins-1); ++j){
-            for(arma::uword k=0; k<8; ++k){
-              workBits[k] = macsOutput[selSites(locus)].haplotypes[i];
-              ++locus;
-            }
-            geno(chr).slice(i/ploidy).col(grp).row(j) = 
-              toByte(workBits);
-          }
-        }
-        // Fill in potentially incomplete bins
-        for(arma::uword k=0; k<8; ++k){
-          if(locus<nSites){
-            workBits[k] = macsOutput[selSites(locus)].haplotypes[i];
-            ++locus;
-          }else{
-            workBits[k] = 0;
-          }
-        }
-        geno(chr).slice(i/ploidy).col(grp).row(nBins-1) = 
-          toByte(workBits);
-        ++grp;
-        grp = grp%ploidy; 
-      }
+    geno(chr).zeros(nBins,decodePloidy,nInd);
+    arma::uword winBins = (nBins+nWindows-1)/nWindows;
+    arma::uword nWin = (nBins>0) ? (nBins+winBins-1)/winBins : 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nWindows)
+#endif
+    for(arma::uword w=0; w<nWin; w++){
+      unsigned long first = w*winBins*8;
+      unsigned long last = std::min<unsigned long>(first+winBins*8, nSites);
+      vector<unsigned long> winSites(selVec.begin()+first, 
+                                     selVec.begin()+last);
+      treeSeq.decodeGeno(winSites, decodePloidy, false, geno(chr).memptr(),
+                         nBins, first);
     }
   }
-  return Rcpp::List::create(Rcpp::Named("geno")=geno,
+  if(!errorMessage.empty()){
+    Rcpp::stop(errorMessage);
+  }
+  Rcpp::List genoList(nChr);
+  for(arma::uword chr=0; chr<nChr; chr++){
+    if(inbred){
+      genoList[chr] = poolInbredGeno(geno(chr).memptr(), geno(chr).n_rows,
+                                     ploidy, nInd);
+      geno(chr).reset();
+    }else{
+      genoList[chr] = Rcpp::wrap(geno(chr));
+    }
+  }
+  return Rcpp::List::create(Rcpp::Named("geno")=genoList,
                             Rcpp::Named("genMap")=genMap);
 }
+
+// Returns the node, edge and site tables of a single MaCS run
+// [[Rcpp::export]]
+Rcpp::List MaCSTreeSeq(Rcpp::String args){
+  string t = args;
+  if (t == "") {
+    Rcpp::stop("error passing argument string");
+  }
+  TreeSequence treeSeq;
+  try{
+    runTreeSeq(parseMaCSConfig(args), treeSeq, false);
+  }catch(const std::exception & e){
+    Rcpp::stop(e.what());
+  }
+  // Node IDs are returned using R indexing
+  Rcpp::IntegerVector edgeParent(treeSeq.edgeParent.begin(),
+                                 treeSeq.edgeParent.end());
+  Rcpp::IntegerVector edgeChild(treeSeq.edgeChild.begin(),
+                                treeSeq.edgeChild.end());
+  Rcpp::IntegerVector siteNode(treeSeq.siteNode.begin(),
+                               treeSeq.siteNode.end());
+  return Rcpp::List::create(
+    Rcpp::Named("nodes")=Rcpp::DataFrame::create(
+      Rcpp::Named("time")=Rcpp::wrap(treeSeq.nodeTime)),
+    Rcpp::Named("edges")=Rcpp::DataFrame::create(
+      Rcpp::Named("left")=Rcpp::wrap(treeSeq.edgeLeft),
+      Rcpp::Named("right")=Rcpp::wrap(treeSeq.edgeRight),
+      Rcpp::Named("parent")=edgeParent+1,
+      Rcpp::Named("child")=edgeChild+1),
+    Rcpp::Named("sites")=Rcpp::DataFrame::create(
+      Rcpp::Named("position")=Rcpp::wrap(treeSeq.sitePosition),
+      Rcpp::Named("node")=siteNode+1),
+    Rcpp::Named("nSample")=treeSeq.iSampleSize);
+}
+
+// Returns the site positions and haplotypes of a single MaCS run 
+// without recording the genealogy, with a row for each site
+// [[Rcpp::export]]
+Rcpp::List MaCSHaplo(Rcpp::String args){
+  string t = args;
+  if (t == "") {
+    Rcpp::stop("error passing argument string");
+  }
+  vector<AlphaSimRReturn> macsOutput;
+  try{
+    macsOutput = runFromAlphaSimR(args);
+  }catch(const std::exception & e){
+    Rcpp::stop(e.what());
+  }
+  arma::uword nSites = macsOutput.size();
+  arma::uword nHap = (nSites>0) ? macsOutput[0].haplotypes.size() : 0;
+  arma::vec position(nSites);
+  arma::Mat<int> haplo(nSites,nHap);
+  for(arma::uword i=0; i<nSites; ++i){
+    position(i) = macsOutput[i].length;
+    for(arma::uword j=0; j<nHap; ++j){
+      haplo(i,j) = macsOutput[i].haplotypes[j];
+    }
+  }
+  return Rcpp::List::create(Rcpp::Named("position")=position,
+                            Rcpp::Named("haplo")=haplo);
+}
+
+// Decodes packed haplotypes for the requested sites of a tree sequence
+// sites must be sorted in ascending order
+// [[Rcpp::export]]
+arma::Cube<unsigned char> decodeTreeSeq(Rcpp::List treeSeqList, 
+                                        arma::uvec sites,
+                                        arma::uword ploidy,
+                                        bool inbred){
+  TreeSequence treeSeq;
+  Rcpp::DataFrame nodes = treeSeqList["nodes"];
+  Rcpp::DataFrame edges = treeSeqList["edges"];
+  Rcpp::DataFrame siteTable = treeSeqList["sites"];
+  treeSeq.nodeTime = Rcpp::as<vector<double> >(nodes["time"]);
+  treeSeq.edgeLeft = Rcpp::as<vector<double> >(edges["left"]);
+  treeSeq.edgeRight = Rcpp::as<vector<double> >(edges["right"]);
+  treeSeq.edgeParent = Rcpp::as<vector<int> >(edges["parent"]);
+  treeSeq.edgeChild = Rcpp::as<vector<int> >(edges["child"]);
+  treeSeq.sitePosition = Rcpp::as<vector<double> >(siteTable["position"]);
+  treeSeq.siteNode = Rcpp::as<vector<int> >(siteTable["node"]);
+  treeSeq.iSampleSize = Rcpp::as<unsigned int>(treeSeqList["nSample"]);
+  // R to C++
+  for(arma::uword i=0; i<treeSeq.edgeParent.size(); ++i){
+    --treeSeq.edgeParent[i];
+    --treeSeq.edgeChild[i];
+  }
+  for(arma::uword i=0; i<treeSeq.siteNode.size(); ++i){
+    --treeSeq.siteNode[i];
+  }
+  sites -= 1;
+  if(!sites.is_sorted()){
+    Rcpp::stop("sites must be sorted");
+  }
+  if((sites.n_elem>0) && (sites.max()>=treeSeq.getTotalSites())){
+    Rcpp::stop("sites exceed the number of sites in the tree sequence");
+  }
+  arma::uword nSites = sites.n_elem;
+  arma::uword nBins = nSites/8;
+  if((nSites%8) > 0){
+    ++nBins;
+  }
+  arma::uword nInd;
+  if(inbred){
+    nInd = treeSeq.iSampleSize;
+  }else{
+    nInd = treeSeq.iSampleSize/ploidy;
+  }
+  arma::Cube<unsigned char> geno(nBins,ploidy,nInd,arma::fill::zeros);
+  vector<unsigned long> selVec(sites.begin(), sites.end());
+  treeSeq.decodeGeno(selVec, ploidy, inbred, geno.memptr());
+  return geno;
+}
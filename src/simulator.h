@@ -3,6 +3,7 @@
 #include <set>
 #include <list>
 #include <queue>
+#include <map>
 //#include<stack>
 #include <boost/weak_ptr.hpp>
 #include <boost/shared_ptr.hpp>
@@ -84,6 +85,9 @@ class Mutation;
 typedef Mutation * MutationPtr;
 typedef vector<MutationPtr> MutationPtrVector;
 
+// A succinct tree sequence recorded while building the graph
+class TreeSequence;
+
 typedef vector<vector<string> > CommandArguments;
 typedef vector<vector<double> > MatrixDouble;
 
@@ -234,6 +238,8 @@ public:
   
   // assign an event with this node
   void setEvent(EventPtr & assoEvent);
+  // row of this node in the tree sequence node table, -1 if not recorded
+  int iTreeSeqId;
   // a place holder to identify a node at the top of the coalescing
   // line.  the height of this node assures that the coalescing
   // line will always be included as a candidate for coalescence
@@ -289,6 +295,9 @@ public:
   ~Event();
   // returns the type based on the constants below
   EventType getType();
+  // returns a new copy of this event, used when each chromosome needs
+  // its own event list
+  virtual Event * clone();
   //    int iGraphIteration;
   // time on the graph from time 0 at bottom
   double getTime();
@@ -306,6 +315,7 @@ class GenericEvent:public Event
 public:
   GenericEvent(EventType iType,double dTime,double dParameterValue);
   double getParamValue();
+  Event * clone();
 private:
   double dParameterValue;
 };
@@ -319,6 +329,7 @@ public:
                      double dPopChangeParam);
   short int getPopulationIndex();
   double getPopChangeParam();
+  Event * clone();
 private:
   short int iPopulationIndex;
   double dPopChangeParam;
@@ -333,6 +344,7 @@ public:
                  short int iPopMigratedTo,short int iPopMigratedFrom);
   short int getPopMigratedTo();
   short int getPopMigratedFrom();
+  Event * clone();
 private:
   short int iPopMigratedTo,iPopMigratedFrom;
 };
@@ -346,6 +358,7 @@ public:
                short int iSourcePop,short int iDestPop);
   short int getSourcePop();
   short int getDestPop();
+  Event * clone();
 private:
   short int iSourcePop,iDestPop;
 };
@@ -361,6 +374,7 @@ public:
   short int getSourcePop();
   short int getDestPop();
   double getRate();
+  Event * clone();
 private:
   short int iSourcePop,iDestPop;
   double dRate;
@@ -375,6 +389,7 @@ public:
   MigrationRateMatrixEvent(EventType iType,double dTime,
                            MatrixDouble dMigrationMatrix);
   MatrixDouble getMigrationMatrix();
+  Event * clone();
   //    ~MigrationRateMatrixEvent();
 private:
   MatrixDouble dMigrationMatrix;
@@ -388,6 +403,7 @@ public:
   CoalEvent(EventType iType,double dTime,
             short int iPopulation);
   short int getPopulation();
+  Event * clone();
   
 private:
   short int iPopulation;
@@ -401,6 +417,7 @@ public:
   XoverEvent(EventType iType,double dTime,
              short int iPopulation);
   short int getPopulation();
+  Event * clone();
 private:
   short int iPopulation;
 };
@@ -459,6 +476,56 @@ public:
   double length;
 };
 
+// Node, edge and site tables describing the genealogy along the
+// chromosome. Sample nodes are always the first rows of the node table,
+// so haplotypes for any subset of sites can be decoded on demand without
+// storing sites x samples.
+class TreeSequence
+{
+public:
+  TreeSequence();
+  // node table
+  vector<double> nodeTime;
+  // edge table, [left,right) intervals on the unit chromosome
+  vector<double> edgeLeft;
+  vector<double> edgeRight;
+  vector<int> edgeParent;
+  vector<int> edgeChild;
+  // site and mutation table, one mutation per site
+  vector<double> sitePosition;
+  vector<int> siteNode;
+  unsigned int iSampleSize;
+  // appends a node and returns its row
+  int addNode(double dTime);
+  // records the edges of the local tree covering [dLeft,dRight)
+  // edges identical to those of the previous tree are extended
+  void addTree(double dLeft,double dRight,
+               const vector<pair<int,int> > & treeEdges);
+  void addSite(double dPosition,int iNode);
+  unsigned int getTotalSites();
+  unsigned int getTotalTrees();
+  // decodes haplotypes for sites in ascending order and packs them
+  // into output, a zeroed nBins x ploidy x nInd column-major array
+  // using the layout of AlphaSimR's geno cubes
+  void decodeGeno(const vector<unsigned long> & selSites,
+                  unsigned int ploidy,bool inbred,
+                  unsigned char * output) const;
+  // as above, writing the sites from iFirstLocus onwards into an array
+  // with nBins rows, so disjoint ranges of sites can be decoded in
+  // parallel
+  void decodeGeno(const vector<unsigned long> & selSites,
+                  unsigned int ploidy,bool inbred,
+                  unsigned char * output,unsigned long nBins,
+                  unsigned long iFirstLocus) const;
+  // appends an edge directly, used by simulators that do not
+  // proceed tree by tree
+  void addEdge(double dLeft,double dRight,int iParent,int iChild);
+private:
+  // open edges of the last tree, keyed by (parent,child)
+  map<pair<int,int>,unsigned int> openEdges;
+  unsigned int iTotalTrees;
+};
+
 class Mutation{
 public:
   Mutation(double dLocation,double dFreq);
@@ -491,6 +558,9 @@ public:
   AlleleFreqBinPtrSet * pAlleleFreqBinPtrSet;
   Configuration();
   ~Configuration();
+  // deep copy with its own event list and bins, so that copies can be
+  // used by different threads
+  Configuration * clone(long iSeed);
 };
 
 class RandNumGenerator{
@@ -507,6 +577,75 @@ private:
 };
 
 
+// Binary indexed tree holding the recombination mass of each
+// segment, allows sampling and updates in O(log n)
+class FenwickTree
+{
+public:
+  FenwickTree();
+  // grows the tree, existing values are kept
+  void resize(unsigned int iSize);
+  unsigned int getSize();
+  void setValue(unsigned int index,double dValue);
+  double getValue(unsigned int index);
+  double getTotal();
+  // sum of values up to and including index
+  double getCumulative(unsigned int index);
+  // first index whose cumulative sum exceeds dValue
+  unsigned int find(double dValue);
+private:
+  vector<double> tree;
+  vector<double> values;
+  unsigned int iSize;
+};
+
+// Exact coalescent with recombination (Hudson 1983) on the unit
+// chromosome. Ancestral material is kept as chains of segments and
+// the genealogy is written to a TreeSequence. Uses the demography of
+// a Configuration built by Simulator::readInputParameters.
+class HudsonBuilder
+{
+public:
+  HudsonBuilder(Configuration *,RandNumGenerator *,TreeSequence *);
+  void build();
+private:
+  RandNumGenerator *pRandNumGenerator;
+  Configuration *pConfig;
+  TreeSequence *pTreeSeq;
+  double dTime;
+  // segment pool, linked lists of segments form lineages
+  vector<double> segLeft,segRight;
+  vector<int> segNode,segPrev,segNext,segPop;
+  vector<int> freeSegments;
+  // recombination mass of every segment
+  FenwickTree links;
+  // heads of the lineages in each population
+  vector<vector<int> > popLineages;
+  // position of a lineage head in popLineages
+  vector<int> lineageIndex;
+  // number of lineages ancestral to each interval
+  map<double,int> overlapCounts;
+  // demography
+  PopVector pPopList;
+  MatrixDouble dMigrationMatrix;
+  unsigned int iTotalLineages;
+  
+  int allocSegment(double dLeft,double dRight,int iNode,int iPop);
+  void freeSegment(int seg);
+  void setSegmentMass(int seg);
+  void addLineage(int head,int pop);
+  void removeLineage(int head);
+  int sampleLineage(int pop);
+  // map key at position, splitting an interval if needed
+  map<double,int>::iterator getOverlapKey(double dPos);
+  void recombinationEvent();
+  void coalescenceEvent(int pop);
+  void migrationEvent();
+  void moveLineage(int head,int pop);
+  void applyEvent(EventPtr & event);
+  void addMutations();
+};
+
 // The main class that implements the Wiuf and Hein
 // algorithm, incorporating demographic events.
 
@@ -516,7 +655,8 @@ class GraphBuilder
 {
 public:
   // This object is initialized with configuration supplied by the user
-  GraphBuilder(Configuration *,RandNumGenerator *);
+  // Supplying a TreeSequence records the genealogy instead of haplotypes
+  GraphBuilder(Configuration *,RandNumGenerator *,TreeSequence * pTreeSeq=NULL);
   ~GraphBuilder();
   // The entry point for building the graph while traversing the
   // the chromosome on the unit interval.
@@ -532,6 +672,8 @@ private:
   Configuration *pConfig;
   
   vector<AlphaSimRReturn> mutations;
+  // Tree sequence recorder, NULL unless in tree sequence mode
+  TreeSequence * pTreeSeq;
   // *** ESSENTIAL CONTAINERS POINTING TO
   // EDGES IN THE GRAPH AND THE MRCAS
   // a linked list of edges on the ARG
@@ -716,6 +858,10 @@ private:
   void checkPopCountIntegrity(PopVector &,double dTime);
   // Prints local tree in Newick format as done in MS
   string getNewickTree(double lastCoalHeight,NodePtr & curNode);
+  // Returns the tree sequence node ID, adding the node if necessary
+  int getTreeSeqId(NodePtr & node);
+  // Records the current local tree in the tree sequence
+  void recordTree(double startPos,double endPos);
   
   
 };
@@ -729,11 +875,19 @@ public:
   // from the command line
   // We can always do more error checking here!
   void readInputParameters(CommandArguments args);
+  // hands the configuration over to the caller
+  Configuration * releaseConfiguration();
   // Calls any coalescent simulator (e.g. fastcoal, MS). In this
   // case, constructs a new graphbuilder and calls the build() function
   void beginSimulation();
   vector<AlphaSimRReturn> beginSimulationMemory();
+  // Records the genealogy in a tree sequence instead of haplotypes
+  void beginSimulationTreeSeq(TreeSequence & treeSeq);
+  // Same as above using the exact coalescent instead of SMC'
+  void beginSimulationHudson(TreeSequence & treeSeq);
   Simulator();
+  // takes ownership of an already parsed configuration
+  Simulator(Configuration * pConfig);
   ~Simulator(); //destructor
   
 private:
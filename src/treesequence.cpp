@@ -0,0 +1,135 @@
+#include <Rcpp.h>
+#include <iostream>
+#include <algorithm>
+#include "simulator.h"
+
+using namespace std;
+
+TreeSequence::TreeSequence(){
+  iSampleSize = 0;
+  iTotalTrees = 0;
+}
+
+int TreeSequence::addNode(double dTime){
+  nodeTime.push_back(dTime);
+  return nodeTime.size()-1;
+}
+
+void TreeSequence::addTree(double dLeft,double dRight,
+                           const vector<pair<int,int> > & treeEdges){
+  map<pair<int,int>,unsigned int> newEdges;
+  vector<pair<int,int> >::const_iterator it;
+  for (it=treeEdges.begin();it!=treeEdges.end();++it){
+    map<pair<int,int>,unsigned int>::iterator found = openEdges.find(*it);
+    if (found!=openEdges.end() && edgeRight[found->second]==dLeft){
+      // edge is shared with the previous tree, extend it
+      edgeRight[found->second] = dRight;
+      newEdges[*it] = found->second;
+    }else{
+      edgeLeft.push_back(dLeft);
+      edgeRight.push_back(dRight);
+      edgeParent.push_back(it->first);
+      edgeChild.push_back(it->second);
+      newEdges[*it] = edgeLeft.size()-1;
+    }
+  }
+  // edges absent from this tree are closed by dropping them
+  openEdges.swap(newEdges);
+  ++iTotalTrees;
+}
+
+void TreeSequence::addSite(double dPosition,int iNode){
+  sitePosition.push_back(dPosition);
+  siteNode.push_back(iNode);
+}
+
+void TreeSequence::addEdge(double dLeft,double dRight,int iParent,int iChild){
+  edgeLeft.push_back(dLeft);
+  edgeRight.push_back(dRight);
+  edgeParent.push_back(iParent);
+  edgeChild.push_back(iChild);
+}
+
+unsigned int TreeSequence::getTotalSites(){
+  return sitePosition.size();
+}
+
+unsigned int TreeSequence::getTotalTrees(){
+  return iTotalTrees;
+}
+
+struct byEdgeCoord{
+  const vector<double> & coord;
+  byEdgeCoord(const vector<double> & coord):coord(coord){}
+  bool operator()(unsigned int i,unsigned int j) const{
+    return coord[i]<coord[j];
+  }
+};
+
+void TreeSequence::decodeGeno(const vector<unsigned long> & selSites,
+                              unsigned int ploidy,bool inbred,
+                              unsigned char * output) const{
+  unsigned long nSites = selSites.size();
+  unsigned long nBins = nSites/8;
+  if ((nSites%8)>0) ++nBins;
+  decodeGeno(selSites,ploidy,inbred,output,nBins,0);
+}
+
+void TreeSequence::decodeGeno(const vector<unsigned long> & selSites,
+                              unsigned int ploidy,bool inbred,
+                              unsigned char * output,unsigned long nBins,
+                              unsigned long iFirstLocus) const{
+  unsigned long nSites = selSites.size();
+  unsigned int nEdges = edgeLeft.size();
+  // insertion order follows the left coordinate of the edges and
+  // removal order their right coordinate
+  vector<unsigned int> insertion(nEdges),removal(nEdges);
+  for (unsigned int i=0;i<nEdges;++i) insertion[i] = removal[i] = i;
+  stable_sort(insertion.begin(),insertion.end(),byEdgeCoord(edgeLeft));
+  stable_sort(removal.begin(),removal.end(),byEdgeCoord(edgeRight));
+  vector<vector<int> > children(nodeTime.size());
+  vector<bool> inTree(nEdges,false);
+  vector<int> stack;
+  unsigned int iInsert=0,iRemove=0;
+  for (unsigned long j=0;j<nSites;++j){
+    double dPos = sitePosition[selSites[j]];
+    // advance the local tree to the site
+    while (iRemove<nEdges && edgeRight[removal[iRemove]]<=dPos){
+      unsigned int e = removal[iRemove];
+      if (inTree[e]){
+        vector<int> & kids = children[edgeParent[e]];
+        kids.erase(find(kids.begin(),kids.end(),edgeChild[e]));
+        inTree[e] = false;
+      }
+      ++iRemove;
+    }
+    while (iInsert<nEdges && edgeLeft[insertion[iInsert]]<=dPos){
+      unsigned int e = insertion[iInsert];
+      if (edgeRight[e]>dPos){
+        children[edgeParent[e]].push_back(edgeChild[e]);
+        inTree[e] = true;
+      }
+      ++iInsert;
+    }
+    // every sample below the mutation carries the derived allele
+    unsigned long locus = iFirstLocus+j;
+    unsigned long bin = locus/8;
+    unsigned char bit = static_cast<unsigned char>(1u<<(locus%8));
+    stack.push_back(siteNode[selSites[j]]);
+    while (!stack.empty()){
+      int node = stack.back();
+      stack.pop_back();
+      if (node<static_cast<int>(iSampleSize)){
+        if (inbred){
+          for (unsigned int grp=0;grp<ploidy;++grp){
+            output[bin+nBins*(grp+ploidy*node)] |= bit;
+          }
+        }else{
+          output[bin+nBins*(node%ploidy+ploidy*(node/ploidy))] |= bit;
+        }
+      }else{
+        stack.insert(stack.end(),children[node].begin(),children[node].end());
+      }
+    }
+  }
+}